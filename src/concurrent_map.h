@@ -36,6 +36,12 @@ public:
 		return {*node_to_value, move(iras)};
 	}
 
+	void Erase(const Key& key) {
+		size_t chosen_position = (static_cast<uint64_t>(key) % static_cast<uint64_t>(undermap_mutex_pair_.size()));
+		std::lock_guard<std::mutex> iras(undermap_mutex_pair_[chosen_position].alone_mutex);
+		undermap_mutex_pair_[chosen_position].undermap.erase(key);
+	}
+
 	std::map<Key, Value> BuildOrdinaryMap() {
 		std::lock_guard<std::mutex> up_lock(something_);
 		std::map<Key, Value> result;
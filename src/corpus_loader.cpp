@@ -0,0 +1,141 @@
+#include "corpus_loader.h"
+
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const size_t RELEASE_STEP = 64 << 20;
+
+DocumentStatus ParseStatus(string_view text) {
+	if (text == "ACTUAL"sv) {
+		return DocumentStatus::ACTUAL;
+	}
+	if (text == "IRRELEVANT"sv) {
+		return DocumentStatus::IRRELEVANT;
+	}
+	if (text == "BANNED"sv) {
+		return DocumentStatus::BANNED;
+	}
+	if (text == "REMOVED"sv) {
+		return DocumentStatus::REMOVED;
+	}
+	throw invalid_argument("Unknown document status "s + string(text));
+}
+
+int ParseInt(string_view text) {
+	int value = 0;
+	const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+	if (error != errc() || end != text.data() + text.size()) {
+		throw invalid_argument("Invalid number "s + string(text));
+	}
+	return value;
+}
+
+// Cuts the field before the next tab off line.
+string_view TakeField(string_view& line) {
+	const size_t tab = line.find('\t');
+	if (tab == line.npos) {
+		throw invalid_argument("Corpus record has too few fields"s);
+	}
+	const string_view field = line.substr(0, tab);
+	line.remove_prefix(tab + 1);
+	return field;
+}
+
+}  // namespace
+
+MappedCorpus::MappedCorpus(const string& path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw system_error(errno, generic_category(), "Can not open corpus "s + path);
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		const int error = errno;
+		close(fd);
+		throw system_error(error, generic_category(), "Can not stat corpus "s + path);
+	}
+	size_ = static_cast<size_t>(file_stat.st_size);
+	if (size_ > 0) {
+		void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED) {
+			const int error = errno;
+			close(fd);
+			throw system_error(error, generic_category(), "Can not map corpus "s + path);
+		}
+		madvise(mapping, size_, MADV_SEQUENTIAL);
+		data_ = static_cast<const char*>(mapping);
+	}
+	close(fd);
+}
+
+MappedCorpus::~MappedCorpus() {
+	if (data_ != nullptr) {
+		munmap(const_cast<char*>(data_), size_);
+	}
+}
+
+bool MappedCorpus::Next(Record& record) {
+	while (position_ < size_) {
+		const size_t line_start = position_;
+		const string_view rest(data_ + position_, size_ - position_);
+		const size_t line_end = min(rest.find('\n'), rest.size());
+		string_view line = rest.substr(0, line_end);
+		position_ += line_end + 1;
+		++line_number_;
+		if (!line.empty() && line.back() == '\r') {
+			line.remove_suffix(1);
+		}
+		if (line.empty()) {
+			continue;
+		}
+		try {
+			record.id = ParseInt(TakeField(line));
+			record.status = ParseStatus(TakeField(line));
+			record.ratings.clear();
+			for (string_view rating : SplitIntoWords(TakeField(line))) {
+				if (!rating.empty()) {
+					record.ratings.push_back(ParseInt(rating));
+				}
+			}
+			record.text = line;
+		} catch (const invalid_argument& error) {
+			throw invalid_argument("Corpus line "s + to_string(line_number_) + ": "s + error.what());
+		}
+		ReleaseReadPages(line_start);
+		return true;
+	}
+	return false;
+}
+
+// The server copies words into its own arena, so text before the current record is never read again.
+void MappedCorpus::ReleaseReadPages(size_t line_start) {
+	if (line_start < released_ + RELEASE_STEP) {
+		return;
+	}
+	const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t release_end = line_start / page_size * page_size;
+	madvise(const_cast<char*>(data_) + released_, release_end - released_, MADV_DONTNEED);
+	released_ = release_end;
+}
+
+size_t LoadCorpus(SearchServer& search_server, const string& path) {
+	MappedCorpus corpus(path);
+	MappedCorpus::Record record;
+	size_t count = 0;
+	while (corpus.Next(record)) {
+		search_server.AddDocument(record.id, record.text, record.status, record.ratings);
+		++count;
+	}
+	return count;
+}
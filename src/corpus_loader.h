@@ -0,0 +1,42 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only memory mapping of a corpus file with one document per line:
+// <id>\t<ACTUAL|IRRELEVANT|BANNED|REMOVED>\t<ratings separated by spaces>\t<text>
+// Record text points straight into the mapping; pages already read are released as the scan goes.
+class MappedCorpus {
+public:
+	struct Record {
+		int id = 0;
+		DocumentStatus status = DocumentStatus::ACTUAL;
+		std::vector<int> ratings;
+		std::string_view text;
+	};
+
+	explicit MappedCorpus(const std::string& path);
+	~MappedCorpus();
+
+	MappedCorpus(const MappedCorpus&) = delete;
+	MappedCorpus& operator=(const MappedCorpus&) = delete;
+
+	// Parses the next non-empty line into record; false at the end of the file.
+	bool Next(Record& record);
+
+private:
+	void ReleaseReadPages(size_t line_start);
+
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+	size_t position_ = 0;
+	size_t released_ = 0;
+	size_t line_number_ = 0;
+};
+
+// Adds every record of the file to the server and returns the number of documents added.
+size_t LoadCorpus(SearchServer& search_server, const std::string& path);
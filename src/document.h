@@ -31,3 +31,5 @@ enum class DocumentStatus {
 	BANNED,
 	REMOVED,
 };
+
+inline constexpr size_t DOCUMENT_STATUS_COUNT = 4;
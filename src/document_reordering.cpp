@@ -0,0 +1,111 @@
+#include "document_reordering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+namespace {
+
+const size_t LEAF_SIZE = 16;
+const int MAX_ITERATIONS = 20;
+
+class GraphBisection {
+public:
+	GraphBisection(const vector<vector<uint32_t>>& document_terms, size_t term_count)
+		: document_terms_(document_terms)
+		, left_degrees_(term_count, 0)
+		, right_degrees_(term_count, 0) {
+	}
+
+	void Bisect(vector<uint32_t>::iterator begin, vector<uint32_t>::iterator end) {
+		const size_t size = end - begin;
+		if (size <= LEAF_SIZE) {
+			return;
+		}
+		const auto middle = begin + size / 2;
+		const double left_size = static_cast<double>(middle - begin);
+		const double right_size = static_cast<double>(end - middle);
+		for (auto it = begin; it != end; ++it) {
+			for (const uint32_t term : document_terms_[*it]) {
+				++(it < middle ? left_degrees_ : right_degrees_)[term];
+			}
+		}
+		vector<pair<double, uint32_t>> left_gains;
+		vector<pair<double, uint32_t>> right_gains;
+		for (int iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+			left_gains.clear();
+			right_gains.clear();
+			for (auto it = begin; it != middle; ++it) {
+				left_gains.emplace_back(ComputeMoveGain(*it, left_degrees_, right_degrees_, left_size, right_size), *it);
+			}
+			for (auto it = middle; it != end; ++it) {
+				right_gains.emplace_back(ComputeMoveGain(*it, right_degrees_, left_degrees_, right_size, left_size), *it);
+			}
+			sort(left_gains.begin(), left_gains.end(), greater<>());
+			sort(right_gains.begin(), right_gains.end(), greater<>());
+			size_t swaps = 0;
+			while (swaps < left_gains.size() && swaps < right_gains.size() && left_gains[swaps].first + right_gains[swaps].first > 0.0) {
+				MoveTerms(left_gains[swaps].second, left_degrees_, right_degrees_);
+				MoveTerms(right_gains[swaps].second, right_degrees_, left_degrees_);
+				++swaps;
+			}
+			if (swaps == 0) {
+				break;
+			}
+			// Swapped documents go to the other half; the rest keep their (gain-sorted) place.
+			auto it = begin;
+			for (size_t i = 0; i < left_gains.size(); ++i) {
+				*it++ = i < swaps ? right_gains[i].second : left_gains[i].second;
+			}
+			for (size_t i = 0; i < right_gains.size(); ++i) {
+				*it++ = i < swaps ? left_gains[i].second : right_gains[i].second;
+			}
+		}
+		for (auto it = begin; it != end; ++it) {
+			for (const uint32_t term : document_terms_[*it]) {
+				left_degrees_[term] = 0;
+				right_degrees_[term] = 0;
+			}
+		}
+		Bisect(begin, middle);
+		Bisect(middle, end);
+	}
+
+private:
+	// Estimated bits per posting of a term with degree documents in a part of size documents.
+	static double ComputeCost(uint32_t degree, double size) {
+		return degree * log2(size / (degree + 1));
+	}
+
+	double ComputeMoveGain(uint32_t document, const vector<uint32_t>& from_degrees, const vector<uint32_t>& to_degrees, double from_size, double to_size) const {
+		double gain = 0.0;
+		for (const uint32_t term : document_terms_[document]) {
+			const uint32_t from = from_degrees[term];
+			const uint32_t to = to_degrees[term];
+			gain += ComputeCost(from, from_size) + ComputeCost(to, to_size) - ComputeCost(from - 1, from_size) - ComputeCost(to + 1, to_size);
+		}
+		return gain;
+	}
+
+	void MoveTerms(uint32_t document, vector<uint32_t>& from_degrees, vector<uint32_t>& to_degrees) const {
+		for (const uint32_t term : document_terms_[document]) {
+			--from_degrees[term];
+			++to_degrees[term];
+		}
+	}
+
+	const vector<vector<uint32_t>>& document_terms_;
+	vector<uint32_t> left_degrees_;
+	vector<uint32_t> right_degrees_;
+};
+
+} // namespace
+
+vector<uint32_t> ComputeBisectionOrder(const vector<vector<uint32_t>>& document_terms, size_t term_count) {
+	vector<uint32_t> order(document_terms.size());
+	iota(order.begin(), order.end(), 0);
+	GraphBisection(document_terms, term_count).Bisect(order.begin(), order.end());
+	return order;
+}
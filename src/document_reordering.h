@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Recursive graph bisection: documents are split in halves, and documents are swapped between the halves
+// while that lowers the estimated cost of the posting gaps (log of the gap per posting), then each half is
+// split again. Documents sharing terms end up with close ordinals.
+// document_terms[i] holds the distinct term numbers (below term_count) of document i.
+// Returns document indexes in their new order.
+std::vector<uint32_t> ComputeBisectionOrder(const std::vector<std::vector<uint32_t>>& document_terms, size_t term_count);
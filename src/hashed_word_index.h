@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Open-addressing hash index from words to values, fronted by a blocked Bloom filter: all the bits of a word
+// lie in one 64-byte block, so a word that was never inserted is usually rejected with a single cache line
+// read and no string comparison. Keys are views; the strings must outlive the index.
+template <typename Value>
+class HashedWordIndex {
+public:
+	explicit HashedWordIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : filter_(resource), slots_(resource) {
+	}
+
+	void Insert(std::string_view word, Value value) {
+		if (2 * (size_ + 1) > slots_.size()) {
+			Rehash(std::max<size_t>(MIN_SLOT_COUNT, 2 * slots_.size()));
+		}
+		const uint64_t hash = std::hash<std::string_view>{}(word);
+		Slot& slot = slots_[FindPosition(hash, word)];
+		if (!slot.is_used) {
+			slot = {hash, word, std::move(value), true};
+			AddToFilter(hash);
+			++size_;
+		} else {
+			slot.value = std::move(value);
+		}
+	}
+
+	// nullptr when word is absent.
+	const Value* Find(std::string_view word) const {
+		if (size_ == 0) {
+			return nullptr;
+		}
+		const uint64_t hash = std::hash<std::string_view>{}(word);
+		if (!MayContain(hash)) {
+			return nullptr;
+		}
+		const Slot& slot = slots_[FindPosition(hash, word)];
+		return slot.is_used ? &slot.value : nullptr;
+	}
+
+	void Clear() {
+		filter_.clear();
+		slots_.clear();
+		size_ = 0;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+private:
+	struct alignas(64) FilterBlock {
+		uint64_t bits[8] = {};
+	};
+
+	struct Slot {
+		uint64_t hash = 0;
+		std::string_view key;
+		Value value = Value();
+		bool is_used = false;
+	};
+
+	static constexpr size_t MIN_SLOT_COUNT = 16;
+	static constexpr int FILTER_HASH_COUNT = 4;
+	// About 8 filter bits per word at the maximum load of one half.
+	static constexpr size_t SLOTS_PER_FILTER_BLOCK = 128;
+
+	// Linear probing from the home slot; returns the slot of word or the empty slot where it would go.
+	size_t FindPosition(uint64_t hash, std::string_view word) const {
+		const size_t mask = slots_.size() - 1;
+		for (size_t position = hash & mask;; position = (position + 1) & mask) {
+			const Slot& slot = slots_[position];
+			if (!slot.is_used || (slot.hash == hash && slot.key == word)) {
+				return position;
+			}
+		}
+	}
+
+	size_t GetBlockIndex(uint64_t hash) const {
+		return static_cast<size_t>(((hash >> 32) * filter_.size()) >> 32);
+	}
+
+	// Bit numbers within the block come from a remix of the hash, independent of the block and slot choice.
+	static uint64_t GetFilterBits(uint64_t hash) {
+		return hash * 0x9E3779B97F4A7C15ull;
+	}
+
+	bool MayContain(uint64_t hash) const {
+		const FilterBlock& block = filter_[GetBlockIndex(hash)];
+		const uint64_t bits = GetFilterBits(hash);
+		for (int i = 0; i < FILTER_HASH_COUNT; ++i) {
+			const uint64_t bit = (bits >> (9 * i)) & 511;
+			if ((block.bits[bit >> 6] & (uint64_t(1) << (bit & 63))) == 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void AddToFilter(uint64_t hash) {
+		FilterBlock& block = filter_[GetBlockIndex(hash)];
+		const uint64_t bits = GetFilterBits(hash);
+		for (int i = 0; i < FILTER_HASH_COUNT; ++i) {
+			const uint64_t bit = (bits >> (9 * i)) & 511;
+			block.bits[bit >> 6] |= uint64_t(1) << (bit & 63);
+		}
+	}
+
+	// slot_count must be a power of two.
+	void Rehash(size_t slot_count) {
+		std::pmr::vector<Slot> old_slots(slot_count, slots_.get_allocator());
+		old_slots.swap(slots_);
+		filter_.assign(std::max<size_t>(1, slot_count / SLOTS_PER_FILTER_BLOCK), FilterBlock());
+		for (Slot& old_slot : old_slots) {
+			if (old_slot.is_used) {
+				AddToFilter(old_slot.hash);
+				slots_[FindPosition(old_slot.hash, old_slot.key)] = std::move(old_slot);
+			}
+		}
+	}
+
+	std::pmr::vector<FilterBlock> filter_;
+	std::pmr::vector<Slot> slots_;
+	size_t size_ = 0;
+};
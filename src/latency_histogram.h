@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+// Log-linear histogram of latencies in nanoseconds: every power of two is split into SUB_BUCKET_COUNT
+// buckets, so any recorded value is kept with a relative error below 1 / SUB_BUCKET_COUNT.
+class LatencyHistogram {
+public:
+	static const int SUB_BUCKET_BITS = 6;
+	static const uint64_t SUB_BUCKET_COUNT = uint64_t(1) << SUB_BUCKET_BITS;
+
+	LatencyHistogram() : counts_(BUCKET_COUNT, 0) {
+	}
+
+	void Record(uint64_t value, uint64_t count = 1) {
+		counts_[GetBucket(value)] += count;
+		total_count_ += count;
+		max_ = std::max(max_, value);
+		sum_ += static_cast<double>(value) * count;
+	}
+
+	// Coordinated omission correction: a request that took value while requests were due every
+	// expected_interval has held back the ones behind it, so their waits are recorded too.
+	void RecordCorrected(uint64_t value, uint64_t expected_interval) {
+		Record(value);
+		if (expected_interval == 0 || value <= expected_interval) {
+			return;
+		}
+		for (uint64_t missed = value - expected_interval; missed >= expected_interval; missed -= expected_interval) {
+			Record(missed);
+		}
+	}
+
+	// Post-run correction for closed-loop measurements, where no send schedule was kept.
+	LatencyHistogram GetCorrectedCopy(uint64_t expected_interval) const {
+		LatencyHistogram result;
+		for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+			for (uint64_t i = 0; i < counts_[bucket]; ++i) {
+				result.RecordCorrected(std::min(GetBucketHighest(bucket), max_), expected_interval);
+			}
+		}
+		return result;
+	}
+
+	void Merge(const LatencyHistogram& other) {
+		for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+			counts_[bucket] += other.counts_[bucket];
+		}
+		total_count_ += other.total_count_;
+		max_ = std::max(max_, other.max_);
+		sum_ += other.sum_;
+	}
+
+	uint64_t GetTotalCount() const {
+		return total_count_;
+	}
+
+	uint64_t GetMax() const {
+		return max_;
+	}
+
+	double GetMean() const {
+		return total_count_ == 0 ? 0.0 : sum_ / total_count_;
+	}
+
+	// Highest value of the bucket holding the given percentile (0..100) of the recorded values.
+	uint64_t GetValueAtPercentile(double percentile) const {
+		const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * total_count_ + 0.5));
+		uint64_t seen = 0;
+		for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+			seen += counts_[bucket];
+			if (seen >= rank) {
+				return std::min(GetBucketHighest(bucket), max_);
+			}
+		}
+		return max_;
+	}
+
+	// Percentile table followed by counts per power of two, values in microseconds.
+	void Print(std::ostream& out) const {
+		using namespace std;
+		out << fixed << setprecision(1);
+		for (const double percentile : {50.0, 75.0, 90.0, 95.0, 99.0, 99.9, 99.99, 100.0}) {
+			out << setw(8) << setprecision(2) << percentile << "%  "s << setprecision(1) << setw(12) << GetValueAtPercentile(percentile) / 1000.0 << " us\n"s;
+		}
+		for (int power = 0; power < 64; ++power) {
+			const uint64_t low = power == 0 ? 0 : uint64_t(1) << power;
+			const uint64_t high = (uint64_t(1) << (power + 1)) - 1;
+			uint64_t count = 0;
+			for (size_t bucket = GetBucket(low); bucket <= GetBucket(high); ++bucket) {
+				count += counts_[bucket];
+			}
+			if (count > 0) {
+				out << setw(12) << low / 1000.0 << " - "s << setw(12) << high / 1000.0 << " us  "s << count << '\n';
+			}
+		}
+	}
+
+private:
+	// Values below 2 * SUB_BUCKET_COUNT get a bucket each; above, the SUB_BUCKET_BITS + 1 leading bits select the bucket.
+	static const size_t BUCKET_COUNT = 2 * SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT;
+
+	static size_t GetBucket(uint64_t value) {
+		if (value < 2 * SUB_BUCKET_COUNT) {
+			return static_cast<size_t>(value);
+		}
+		int shift = 0;
+		while ((value >> shift) >= 2 * SUB_BUCKET_COUNT) {
+			++shift;
+		}
+		return static_cast<size_t>(2 * SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT));
+	}
+
+	static uint64_t GetBucketHighest(size_t bucket) {
+		if (bucket < 2 * SUB_BUCKET_COUNT) {
+			return bucket;
+		}
+		const int shift = static_cast<int>((bucket - 2 * SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT) + 1;
+		const uint64_t leading = SUB_BUCKET_COUNT + (bucket - 2 * SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+		return ((leading + 1) << shift) - 1;
+	}
+
+	std::vector<uint64_t> counts_;
+	uint64_t total_count_ = 0;
+	uint64_t max_ = 0;
+	double sum_ = 0.0;
+};
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Deterministic Levenshtein automaton for one word, simulated bit-parallel: a state is max_edits + 1
+// 64-bit rows, bit i of row d set when the first i letters of the word are within d edits of
+// the input read so far.
+class LevenshteinAutomaton {
+public:
+	// Bit i of a row stands for a word prefix of i letters, so longer words do not fit.
+	static constexpr size_t MAX_WORD_SIZE = 63;
+	// Ranges up to this many words are scanned one word at a time instead of walked: the length check alone
+	// rejects most words, and a walk's letter searches only pay off once many words share their prefixes.
+	static constexpr size_t SCAN_MAX_WORDS = 512;
+
+	// word must be at most MAX_WORD_SIZE letters.
+	LevenshteinAutomaton(std::string_view word, int max_edits)
+		: word_size_(word.size())
+		, max_edits_(max_edits)
+		, all_prefixes_((uint64_t{2} << word.size()) - 1) {
+		for (size_t i = 0; i < word.size(); ++i) {
+			letter_masks_[static_cast<unsigned char>(word[i])] |= uint64_t{2} << i;
+		}
+		for (unsigned letter = 0; letter <= UINT8_MAX; ++letter) {
+			if (letter_masks_[letter] != 0) {
+				letters_.push_back(static_cast<char>(letter));
+			}
+		}
+	}
+
+	size_t GetStateSize() const {
+		return static_cast<size_t>(max_edits_) + 1;
+	}
+
+	// Input longer than this can not match.
+	size_t GetMaxInputSize() const {
+		return word_size_ + max_edits_;
+	}
+
+	void Start(uint64_t* state) const {
+		for (int edits = 0; edits <= max_edits_; ++edits) {
+			state[edits] = ((uint64_t{2} << edits) - 1) & all_prefixes_;
+		}
+	}
+
+	// Returns CanMatch(next).
+	bool Step(const uint64_t* state, char c, uint64_t* next) const {
+		const uint64_t matches = letter_masks_[static_cast<unsigned char>(c)];
+		next[0] = (state[0] << 1) & matches;
+		for (int edits = 1; edits <= max_edits_; ++edits) {
+			// Match, then substitution, insertion and deletion of a letter at one more edit.
+			next[edits] = (((state[edits] << 1) & matches) | (state[edits - 1] << 1) | state[edits - 1] | (next[edits - 1] << 1)) & all_prefixes_;
+		}
+		return next[max_edits_] != 0;
+	}
+
+	bool IsMatch(const uint64_t* state) const {
+		return (state[max_edits_] >> word_size_) & 1;
+	}
+
+	// False once no continuation of the input can come within max_edits of the word.
+	bool CanMatch(const uint64_t* state) const {
+		return state[max_edits_] != 0;
+	}
+
+	// Defined for matching states only.
+	int GetDistance(const uint64_t* state) const {
+		int edits = 0;
+		while (!((state[edits] >> word_size_) & 1)) {
+			++edits;
+		}
+		return edits;
+	}
+
+	// Smallest letter not less than first that keeps state alive. Letters absent from the word all step
+	// alike, so when such a step is dead only the word's own letters are tried.
+	std::optional<char> FindNextLetter(const uint64_t* state, unsigned first) const {
+		if (first > UINT8_MAX) {
+			return std::nullopt;
+		}
+		if (IsAliveAfter(state, 0)) {
+			return static_cast<char>(first);
+		}
+		for (const char letter : letters_) {
+			if (static_cast<unsigned char>(letter) >= first && IsAliveAfter(state, letter_masks_[static_cast<unsigned char>(letter)])) {
+				return letter;
+			}
+		}
+		return std::nullopt;
+	}
+
+	// Calls callback(word, distance) for the words of the sorted random-access range [first, last) within
+	// max_edits of the word, in order. Words with a common prefix are adjacent, so the walk descends letter
+	// by letter within the range of its prefix and jumps straight to the next live letter with a binary
+	// search on one character, never visiting the words under a dead prefix.
+	template <typename RandomIt, typename Callback>
+	void ForEachMatch(RandomIt first, RandomIt last, Callback callback) const {
+		if (first == last) {
+			return;
+		}
+		std::vector<uint64_t> states((GetMaxInputSize() + 2) * GetStateSize());
+		if (static_cast<size_t>(last - first) <= SCAN_MAX_WORDS) {
+			for (; first != last; ++first) {
+				if (const auto distance = Match(*first, states.data())) {
+					callback(*first, *distance);
+				}
+			}
+			return;
+		}
+		Start(states.data());
+		Walk(first, 0, static_cast<size_t>(last - first), 0, states.data(), callback);
+	}
+
+private:
+	// Edit distance of input, nullopt beyond max_edits. states holds two states.
+	std::optional<int> Match(std::string_view input, uint64_t* states) const {
+		if (input.size() > GetMaxInputSize() || input.size() + max_edits_ < word_size_) {
+			return std::nullopt;
+		}
+		uint64_t* state = states;
+		uint64_t* next = states + GetStateSize();
+		Start(state);
+		for (const char c : input) {
+			if (!Step(state, c, next)) {
+				return std::nullopt;
+			}
+			std::swap(state, next);
+		}
+		if (!IsMatch(state)) {
+			return std::nullopt;
+		}
+		return GetDistance(state);
+	}
+
+	// Every word in [first, last) of words starts with the depth letters read into state.
+	template <typename RandomIt, typename Callback>
+	void Walk(RandomIt words, size_t first, size_t last, size_t depth, uint64_t* state, Callback& callback) const {
+		if (words[first].size() == depth) {
+			if (IsMatch(state)) {
+				callback(words[first], GetDistance(state));
+			}
+			++first;
+		}
+		uint64_t* next = state + GetStateSize();
+		// First word from `from` on whose letter at depth is not less than letter. Siblings are usually close,
+		// so the search gallops from `from` before bisecting.
+		const auto find_letter = [words, depth, last](size_t from, unsigned letter) {
+			const auto is_before = [depth, letter](std::string_view word) {
+				return static_cast<unsigned char>(word[depth]) < letter;
+			};
+			size_t bound = from;
+			for (size_t step = 1; bound < last && is_before(words[bound]); step *= 2) {
+				from = bound + 1;
+				bound = std::min(last, bound + step);
+			}
+			return static_cast<size_t>(std::partition_point(words + from, words + bound, is_before) - words);
+		};
+		for (unsigned letter = 0; first != last;) {
+			const auto live_letter = FindNextLetter(state, letter);
+			if (!live_letter) {
+				return;
+			}
+			first = find_letter(first, static_cast<unsigned char>(*live_letter));
+			if (first == last) {
+				return;
+			}
+			letter = static_cast<unsigned char>(words[first][depth]);
+			if (letter != static_cast<unsigned char>(*live_letter)) {
+				// No word continues with the live letter: try again from the letter that is there.
+				continue;
+			}
+			const size_t letter_last = find_letter(first, letter + 1);
+			Step(state, *live_letter, next);
+			Walk(words, first, letter_last, depth + 1, next, callback);
+			first = letter_last;
+			++letter;
+		}
+	}
+
+	bool IsAliveAfter(const uint64_t* state, uint64_t matches) const {
+		uint64_t previous = (state[0] << 1) & matches;
+		for (int edits = 1; edits <= max_edits_; ++edits) {
+			previous = (((state[edits] << 1) & matches) | (state[edits - 1] << 1) | state[edits - 1] | (previous << 1)) & all_prefixes_;
+		}
+		return previous != 0;
+	}
+
+	size_t word_size_;
+	int max_edits_;
+	uint64_t all_prefixes_;
+	std::array<uint64_t, 256> letter_masks_{};
+	// Distinct letters of the word in byte order.
+	std::string letters_;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+// Forwards to an upstream resource and keeps exact byte and block counts of what is live.
+class CountingResource : public std::pmr::memory_resource {
+public:
+	explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) : upstream_(upstream) {
+	}
+
+	size_t GetAllocatedBytes() const {
+		return allocated_bytes_.load(std::memory_order_relaxed);
+	}
+
+	size_t GetAllocationCount() const {
+		return allocation_count_.load(std::memory_order_relaxed);
+	}
+
+	std::pmr::memory_resource* GetUpstream() const {
+		return upstream_;
+	}
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override {
+		void* result = upstream_->allocate(bytes, alignment);
+		allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+		allocation_count_.fetch_add(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+		upstream_->deallocate(pointer, bytes, alignment);
+		allocated_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+		allocation_count_.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+
+	std::pmr::memory_resource* upstream_;
+	std::atomic<size_t> allocated_bytes_ = 0;
+	std::atomic<size_t> allocation_count_ = 0;
+};
+
+struct MemoryStats {
+	size_t stop_words = 0;
+	size_t word_to_document_freqs = 0;
+	// Hash table and Bloom filter over the dictionary words.
+	size_t word_index = 0;
+	size_t document_to_word_freqs = 0;
+	size_t documents = 0;
+	size_t document_ordinals = 0;
+	// Word-set fingerprints kept by duplicate detection.
+	size_t fingerprints = 0;
+	size_t document_ids = 0;
+	size_t positions = 0;
+	size_t impact_postings = 0;
+	// Words in byte order for prefix and fuzzy expansion.
+	size_t term_dictionary = 0;
+	size_t words = 0;
+	size_t allocation_count = 0;
+	// Part of words: arena bytes not holding word characters, i.e. the unused tail of the last block.
+	size_t word_arena_slack = 0;
+
+	// Bytes requested from the upstream resource, exact.
+	size_t GetTotalBytes() const {
+		return stop_words + word_to_document_freqs + word_index + document_to_word_freqs + documents + document_ordinals + fingerprints + document_ids + positions
+			+ impact_postings + term_dictionary + words;
+	}
+
+	// A guess, not a measurement: what a general-purpose upstream spends on top of GetTotalBytes, taken as a
+	// flat ALLOCATION_OVERHEAD bytes of header and rounding per live block, which is typical of malloc. The
+	// real figure depends on the allocator and block sizes; arena and pool upstreams differ widely.
+	static constexpr size_t ALLOCATION_OVERHEAD = 16;
+
+	size_t GetAllocatorOverheadEstimate() const {
+		return allocation_count * ALLOCATION_OVERHEAD;
+	}
+};
+
+template <typename Stream>
+Stream& operator<<(Stream& out, const MemoryStats& stats) {
+	using namespace std;
+	out << "{ "s
+		<< "stop_words = "s << stats.stop_words << ", "s
+		<< "word_to_document_freqs = "s << stats.word_to_document_freqs << ", "s
+		<< "word_index = "s << stats.word_index << ", "s
+		<< "document_to_word_freqs = "s << stats.document_to_word_freqs << ", "s
+		<< "documents = "s << stats.documents << ", "s
+		<< "document_ordinals = "s << stats.document_ordinals << ", "s
+		<< "fingerprints = "s << stats.fingerprints << ", "s
+		<< "document_ids = "s << stats.document_ids << ", "s
+		<< "positions = "s << stats.positions << ", "s
+		<< "impact_postings = "s << stats.impact_postings << ", "s
+		<< "term_dictionary = "s << stats.term_dictionary << ", "s
+		<< "words = "s << stats.words << ", "s
+		<< "word_arena_slack = "s << stats.word_arena_slack << ", "s
+		<< "allocation_count = "s << stats.allocation_count << ", "s
+		<< "total = "s << stats.GetTotalBytes() << ", "s
+		<< "allocator_overhead_estimate = "s << stats.GetAllocatorOverheadEstimate() << " }"s;
+	return out;
+}
+
+// Memory held for one dictionary word: its posting list and, when kept, its impact-ordered copy and
+// positions. Tree nodes and the word's characters are shared structure and not included.
+struct TermMemory {
+	std::string_view word;
+	size_t document_count = 0;
+	size_t bytes = 0;
+};
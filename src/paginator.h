@@ -1,6 +1,10 @@
 #pragma once
 
+#include "search_server.h"
+
 #include <iostream>
+#include <iterator>
+#include <optional>
 #include <vector>
 
 template <typename Iterator>
@@ -71,3 +75,84 @@ template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
 	return Paginator(c.begin(), c.end(), page_size);
 }
+
+// Pages are fetched on demand: PageSource is called as source(last, page_size), where last is the
+// final item of the previous page (empty for the first page), and returns the next page.
+template <typename Item, typename PageSource>
+class LazyPaginator {
+public:
+	class PageIterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = std::vector<Item>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+
+		PageIterator() = default;
+
+		explicit PageIterator(const LazyPaginator* paginator)
+			: paginator_(paginator)
+			, page_(paginator->source_(std::nullopt, paginator->page_size_)) {
+		}
+
+		reference operator*() const {
+			return page_;
+		}
+
+		pointer operator->() const {
+			return &page_;
+		}
+
+		PageIterator& operator++() {
+			if (page_.size() < paginator_->page_size_) {
+				page_.clear();
+			} else {
+				const std::optional<Item> last = page_.back();
+				page_ = paginator_->source_(last, paginator_->page_size_);
+			}
+			return *this;
+		}
+
+		// An exhausted iterator has an empty page; that is all end() comparisons need.
+		bool operator==(const PageIterator& other) const {
+			return page_.empty() && other.page_.empty();
+		}
+
+		bool operator!=(const PageIterator& other) const {
+			return !(*this == other);
+		}
+
+	private:
+		const LazyPaginator* paginator_ = nullptr;
+		std::vector<Item> page_;
+	};
+
+	LazyPaginator(PageSource source, size_t page_size)
+		: source_(std::move(source))
+		, page_size_(page_size) {
+	}
+
+	PageIterator begin() const {
+		if (page_size_ == 0) {
+			return PageIterator();
+		}
+		return PageIterator(this);
+	}
+
+	PageIterator end() const {
+		return PageIterator();
+	}
+
+private:
+	PageSource source_;
+	size_t page_size_;
+};
+
+template <typename DocumentFilter = DocumentStatus>
+auto PaginateSearch(const SearchServer& search_server, std::string raw_query, size_t page_size, DocumentFilter document_filter = DocumentStatus::ACTUAL) {
+	auto source = [&search_server, raw_query = std::move(raw_query), document_filter](const std::optional<Document>& last, size_t page_size) {
+		return search_server.FindTopDocumentsAfter(raw_query, last, page_size, document_filter);
+	};
+	return LazyPaginator<Document, decltype(source)>(std::move(source), page_size);
+}
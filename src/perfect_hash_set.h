@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable set of strings with a hash-and-displace perfect hash: keys are split into buckets and every
+// bucket gets the first seed that sends all its keys to free slots, so a lookup hashes once, reads one
+// seed and compares one slot. The key bytes are copied into one buffer of the set, so it does not depend
+// on the strings it was built from and can be copied and moved with its owner.
+class PerfectHashSet {
+public:
+	explicit PerfectHashSet(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : seeds_(resource), slots_(resource), key_bytes_(resource) {
+	}
+
+	template <typename StringContainer>
+	PerfectHashSet(const StringContainer& keys, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : PerfectHashSet(resource) {
+		std::vector<std::string_view> unique_keys(keys.begin(), keys.end());
+		std::sort(unique_keys.begin(), unique_keys.end());
+		unique_keys.erase(std::unique(unique_keys.begin(), unique_keys.end()), unique_keys.end());
+		Build(unique_keys);
+	}
+
+	bool Contains(std::string_view key) const {
+		if (slots_.empty()) {
+			return false;
+		}
+		const uint64_t hash = std::hash<std::string_view>{}(key);
+		const Slot& slot = slots_[GetSlot(hash, seeds_[hash % seeds_.size()])];
+		return slot.hash == hash && std::string_view(key_bytes_).substr(slot.key_offset, slot.key_size) == key;
+	}
+
+private:
+	struct Slot {
+		uint64_t hash = 0;
+		// Key at key_bytes_[key_offset, key_offset + key_size).
+		uint32_t key_offset = 0;
+		uint32_t key_size = 0;
+		bool is_used = false;
+	};
+
+	static const size_t KEYS_PER_BUCKET = 4;
+	static const uint32_t MAX_SEED = 1 << 16;
+
+	size_t GetSlot(uint64_t hash, uint32_t seed) const {
+		return static_cast<size_t>(((hash ^ (seed * 0x9E3779B97F4A7C15ull)) * 0xFF51AFD7ED558CCDull) >> 32) % slots_.size();
+	}
+
+	void Build(const std::vector<std::string_view>& keys) {
+		if (keys.empty()) {
+			return;
+		}
+		std::vector<uint64_t> hashes;
+		std::vector<uint32_t> key_offsets;
+		for (const std::string_view key : keys) {
+			hashes.push_back(std::hash<std::string_view>{}(key));
+			key_offsets.push_back(static_cast<uint32_t>(key_bytes_.size()));
+			key_bytes_.append(key);
+		}
+		// A quarter of spare slots keeps the seed search short; retry with more if a bucket gets stuck.
+		for (size_t slot_count = keys.size() + keys.size() / 4 + 1;; slot_count *= 2) {
+			seeds_.assign(keys.size() / KEYS_PER_BUCKET + 1, 0);
+			slots_.assign(slot_count, Slot());
+			if (TryPlace(keys, hashes, key_offsets)) {
+				return;
+			}
+		}
+	}
+
+	bool TryPlace(const std::vector<std::string_view>& keys, const std::vector<uint64_t>& hashes, const std::vector<uint32_t>& key_offsets) {
+		std::vector<std::vector<size_t>> buckets(seeds_.size());
+		for (size_t i = 0; i < keys.size(); ++i) {
+			buckets[hashes[i] % seeds_.size()].push_back(i);
+		}
+		std::vector<size_t> order(buckets.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			order[i] = i;
+		}
+		// Largest buckets first, while most slots are still free.
+		std::stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+			return buckets[lhs].size() > buckets[rhs].size();
+		});
+		std::vector<size_t> positions;
+		for (const size_t bucket : order) {
+			bool is_placed = buckets[bucket].empty();
+			for (uint32_t seed = 0; !is_placed && seed < MAX_SEED; ++seed) {
+				positions.clear();
+				for (const size_t key : buckets[bucket]) {
+					const size_t position = GetSlot(hashes[key], seed);
+					if (slots_[position].is_used || std::find(positions.begin(), positions.end(), position) != positions.end()) {
+						break;
+					}
+					positions.push_back(position);
+				}
+				if (positions.size() == buckets[bucket].size()) {
+					seeds_[bucket] = seed;
+					for (size_t i = 0; i < positions.size(); ++i) {
+						const size_t key = buckets[bucket][i];
+						slots_[positions[i]] = {hashes[key], key_offsets[key], static_cast<uint32_t>(keys[key].size()), true};
+					}
+					is_placed = true;
+				}
+			}
+			if (!is_placed) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::pmr::vector<uint32_t> seeds_;
+	std::pmr::vector<Slot> slots_;
+	std::pmr::string key_bytes_;
+};
@@ -0,0 +1,120 @@
+#include "positional_index.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+PositionalIndex::PositionalIndex(pmr::memory_resource* resource) : word_positions_(resource) {
+}
+
+void PositionalIndex::Add(string_view word, uint32_t ordinal, const vector<uint32_t>& positions) {
+	auto& word_positions = word_positions_.try_emplace(word).first->second;
+	const uint32_t begin = static_cast<uint32_t>(word_positions.bytes.size());
+	uint32_t previous = 0;
+	for (const uint32_t position : positions) {
+		uint32_t delta = position - previous;
+		previous = position;
+		while (delta >= 0x80) {
+			word_positions.bytes.push_back(static_cast<uint8_t>(delta | 0x80));
+			delta >>= 7;
+		}
+		word_positions.bytes.push_back(static_cast<uint8_t>(delta));
+	}
+	const Entry entry{ordinal, begin, static_cast<uint32_t>(word_positions.bytes.size())};
+	auto& entries = word_positions.entries;
+	if (entries.empty() || entries.back().ordinal < ordinal) {
+		entries.push_back(entry);
+	} else {
+		entries.insert(word_positions.Find(ordinal), entry);
+	}
+}
+
+void PositionalIndex::Remove(string_view word, uint32_t ordinal) {
+	const auto word_it = word_positions_.find(word);
+	if (word_it == word_positions_.end()) {
+		return;
+	}
+	auto& word_positions = word_it->second;
+	const auto entry = word_positions.Find(ordinal);
+	if (entry == word_positions.entries.end() || entry->ordinal != ordinal) {
+		return;
+	}
+	word_positions.dead_bytes += entry->end - entry->begin;
+	word_positions.entries.erase(entry);
+	if (word_positions.dead_bytes * 2 > word_positions.bytes.size()) {
+		word_positions.Compact();
+	}
+}
+
+void PositionalIndex::Remap(const vector<uint32_t>& new_ordinals) {
+	for (auto& [_, word_positions] : word_positions_) {
+		for (Entry& entry : word_positions.entries) {
+			entry.ordinal = new_ordinals[entry.ordinal];
+		}
+		word_positions.entries.erase(remove_if(word_positions.entries.begin(), word_positions.entries.end(), [](const Entry& entry) {
+			return entry.ordinal == numeric_limits<uint32_t>::max();
+		}), word_positions.entries.end());
+		sort(word_positions.entries.begin(), word_positions.entries.end(), [](const Entry& lhs, const Entry& rhs) {
+			return lhs.ordinal < rhs.ordinal;
+		});
+		// Also lays the bytes out in the new document order.
+		word_positions.Compact();
+	}
+}
+
+bool PositionalIndex::GetPositions(string_view word, uint32_t ordinal, vector<uint32_t>& result) const {
+	result.clear();
+	const auto word_it = word_positions_.find(word);
+	if (word_it == word_positions_.end()) {
+		return false;
+	}
+	const auto& word_positions = word_it->second;
+	const auto entry = word_positions.Find(ordinal);
+	if (entry == word_positions.entries.end() || entry->ordinal != ordinal) {
+		return false;
+	}
+	uint32_t position = 0;
+	uint32_t delta = 0;
+	int shift = 0;
+	for (uint32_t i = entry->begin; i < entry->end; ++i) {
+		const uint8_t byte = word_positions.bytes[i];
+		delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+		if (byte & 0x80) {
+			shift += 7;
+		} else {
+			position += delta;
+			result.push_back(position);
+			delta = 0;
+			shift = 0;
+		}
+	}
+	return true;
+}
+
+size_t PositionalIndex::GetMemoryUsage(string_view word) const {
+	const auto word_it = word_positions_.find(word);
+	if (word_it == word_positions_.end()) {
+		return 0;
+	}
+	return word_it->second.entries.capacity() * sizeof(Entry) + word_it->second.bytes.capacity();
+}
+
+pmr::vector<PositionalIndex::Entry>::const_iterator PositionalIndex::WordPositions::Find(uint32_t ordinal) const {
+	return lower_bound(entries.begin(), entries.end(), ordinal, [](const Entry& entry, uint32_t value) {
+		return entry.ordinal < value;
+	});
+}
+
+void PositionalIndex::WordPositions::Compact() {
+	pmr::vector<uint8_t> compacted(bytes.get_allocator());
+	compacted.reserve(bytes.size() - dead_bytes);
+	for (Entry& entry : entries) {
+		const uint32_t begin = static_cast<uint32_t>(compacted.size());
+		compacted.insert(compacted.end(), bytes.begin() + entry.begin, bytes.begin() + entry.end);
+		entry.begin = begin;
+		entry.end = static_cast<uint32_t>(compacted.size());
+	}
+	bytes = move(compacted);
+	dead_bytes = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Word positions kept apart from term frequencies, so queries without phrase or NEAR operators never touch them.
+// Positions of one word in one document are stored as delta-encoded varints in a per-word byte buffer.
+class PositionalIndex {
+public:
+	explicit PositionalIndex(std::pmr::memory_resource* resource);
+
+	// word is not copied: it must outlive the index (the server passes keys of its own dictionary).
+	void Add(std::string_view word, uint32_t ordinal, const std::vector<uint32_t>& positions);
+	void Remove(std::string_view word, uint32_t ordinal);
+	// Renumbers the documents after a reordering: new_ordinals is indexed by the old ordinal, and documents
+	// mapped to UINT32_MAX are dropped.
+	void Remap(const std::vector<uint32_t>& new_ordinals);
+
+	// Fills result with the sorted positions of word in the document; false if the word does not occur there.
+	bool GetPositions(std::string_view word, uint32_t ordinal, std::vector<uint32_t>& result) const;
+	// Bytes of the entries and position buffer of word, 0 if it has none.
+	size_t GetMemoryUsage(std::string_view word) const;
+
+private:
+	struct Entry {
+		uint32_t ordinal;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	struct WordPositions {
+		using allocator_type = std::pmr::polymorphic_allocator<Entry>;
+
+		explicit WordPositions(const allocator_type& allocator) : entries(allocator), bytes(allocator) {
+		}
+
+		WordPositions(const WordPositions& other, const allocator_type& allocator)
+			: entries(other.entries, allocator)
+			, bytes(other.bytes, allocator)
+			, dead_bytes(other.dead_bytes) {
+		}
+
+		WordPositions(WordPositions&& other, const allocator_type& allocator)
+			: entries(std::move(other.entries), allocator)
+			, bytes(std::move(other.bytes), allocator)
+			, dead_bytes(other.dead_bytes) {
+		}
+
+		std::pmr::vector<Entry>::const_iterator Find(uint32_t ordinal) const;
+		void Compact();
+
+		std::pmr::vector<Entry> entries;
+		std::pmr::vector<uint8_t> bytes;
+		size_t dead_bytes = 0;
+	};
+
+	std::pmr::map<std::string_view, WordPositions> word_positions_;
+};
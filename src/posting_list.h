@@ -0,0 +1,302 @@
+#pragma once
+
+#include "document.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+struct Posting {
+	uint32_t ordinal;
+	double term_freq;
+};
+
+// Postings of one word sorted by document ordinal (the server's internal dense document number),
+// stored contiguously so that a word costs one allocation instead of one tree node per document.
+// Erasing from the middle shifts the rest of the list, so postings of removed documents, and of documents
+// moved to another status, are only counted with MarkRemoved and stay in place, skipped by the readers,
+// until a Sweep or a Remap drops them.
+class PostingList {
+public:
+	// Ordinal of Remap for the postings to drop.
+	static constexpr uint32_t DROPPED = std::numeric_limits<uint32_t>::max();
+
+	using allocator_type = std::pmr::polymorphic_allocator<Posting>;
+	using const_iterator = std::pmr::vector<Posting>::const_iterator;
+
+	PostingList() = default;
+
+	explicit PostingList(const allocator_type& allocator) : postings_(allocator) {
+	}
+
+	PostingList(const PostingList& other, const allocator_type& allocator) : postings_(other.postings_, allocator), removed_count_(other.removed_count_) {
+	}
+
+	PostingList(PostingList&& other, const allocator_type& allocator) : postings_(std::move(other.postings_), allocator), removed_count_(other.removed_count_) {
+	}
+
+	void Add(uint32_t ordinal, double term_freq) {
+		if (postings_.empty() || postings_.back().ordinal < ordinal) {
+			postings_.push_back({ordinal, term_freq});
+			return;
+		}
+		const auto it = LowerBound(ordinal);
+		if (it != postings_.end() && it->ordinal == ordinal) {
+			postings_[it - postings_.begin()].term_freq += term_freq;
+		} else {
+			postings_.insert(it, {ordinal, term_freq});
+		}
+	}
+
+	bool Erase(uint32_t ordinal) {
+		const auto it = LowerBound(ordinal);
+		if (it == postings_.end() || it->ordinal != ordinal) {
+			return false;
+		}
+		postings_.erase(it);
+		return true;
+	}
+
+	bool Contains(uint32_t ordinal) const {
+		const auto it = LowerBound(ordinal);
+		return it != postings_.end() && it->ordinal == ordinal;
+	}
+
+	// The posting of a removed document is left for the next Sweep or Remap.
+	void MarkRemoved() {
+		++removed_count_;
+	}
+
+	// A posting marked removed is live again: its document came back to this list's status.
+	void Restore() {
+		--removed_count_;
+	}
+
+	// Postings marked removed still in the list.
+	size_t GetRemovedCount() const {
+		return removed_count_;
+	}
+
+	// Drops the postings marked removed, those for which is_removed(ordinal) holds.
+	template <typename Predicate>
+	void Sweep(Predicate is_removed) {
+		postings_.erase(std::remove_if(postings_.begin(), postings_.end(), [&is_removed](const Posting& posting) {
+			return is_removed(posting.ordinal);
+		}), postings_.end());
+		removed_count_ = 0;
+	}
+
+	// Renumbers the documents after a reordering or compaction: new_ordinals is indexed by the old ordinal,
+	// and postings mapped to DROPPED, those of removed documents among them, are dropped. Postings marked
+	// removed for a status move are mapped like live ones, so they are swept first.
+	void Remap(const std::vector<uint32_t>& new_ordinals) {
+		for (Posting& posting : postings_) {
+			posting.ordinal = new_ordinals[posting.ordinal];
+		}
+		postings_.erase(std::remove_if(postings_.begin(), postings_.end(), [](const Posting& posting) {
+			return posting.ordinal == DROPPED;
+		}), postings_.end());
+		std::sort(postings_.begin(), postings_.end(), [](const Posting& lhs, const Posting& rhs) {
+			return lhs.ordinal < rhs.ordinal;
+		});
+		removed_count_ = 0;
+	}
+
+	const_iterator LowerBound(uint32_t ordinal) const {
+		return std::lower_bound(postings_.begin(), postings_.end(), ordinal, IsBefore);
+	}
+
+	// Galloping search forward from a previous position: cost grows with the log of the distance
+	// skipped, not of the list length, which is what intersections in increasing id order need.
+	const_iterator Seek(const_iterator from, uint32_t ordinal) const {
+		size_t step = 1;
+		const_iterator low = from;
+		while (static_cast<size_t>(postings_.end() - low) > step && (low + step)->ordinal < ordinal) {
+			low += step;
+			step *= 2;
+		}
+		const const_iterator high = static_cast<size_t>(postings_.end() - low) > step ? low + step + 1 : postings_.end();
+		return std::lower_bound(low, high, ordinal, IsBefore);
+	}
+
+	// Postings marked removed included.
+	const_iterator begin() const {
+		return postings_.begin();
+	}
+
+	const_iterator end() const {
+		return postings_.end();
+	}
+
+	size_t size() const {
+		return postings_.size();
+	}
+
+	bool empty() const {
+		return postings_.empty();
+	}
+
+	size_t GetMemoryUsage() const {
+		return postings_.capacity() * sizeof(Posting);
+	}
+
+private:
+	static bool IsBefore(const Posting& posting, uint32_t ordinal) {
+		return posting.ordinal < ordinal;
+	}
+
+	std::pmr::vector<Posting> postings_;
+	size_t removed_count_ = 0;
+};
+
+// Postings of one word split by document status into one PostingList per DocumentStatus: a query for one
+// status reads only its partition, and a status change moves a posting between two partitions.
+class PartitionedPostingList {
+public:
+	using allocator_type = PostingList::allocator_type;
+
+	PartitionedPostingList() = default;
+
+	explicit PartitionedPostingList(const allocator_type& allocator)
+		: partitions_(MakePartitions([&allocator](size_t) { return PostingList(allocator); }, STATUSES)) {
+	}
+
+	PartitionedPostingList(const PartitionedPostingList& other, const allocator_type& allocator)
+		: partitions_(MakePartitions([&other, &allocator](size_t status) { return PostingList(other.partitions_[status], allocator); }, STATUSES)) {
+	}
+
+	PartitionedPostingList(PartitionedPostingList&& other, const allocator_type& allocator)
+		: partitions_(MakePartitions([&other, &allocator](size_t status) { return PostingList(std::move(other.partitions_[status]), allocator); }, STATUSES)) {
+	}
+
+	void Add(uint32_t ordinal, DocumentStatus status, double term_freq) {
+		partitions_[static_cast<size_t>(status)].Add(ordinal, term_freq);
+	}
+
+	void MarkRemoved(DocumentStatus status) {
+		partitions_[static_cast<size_t>(status)].MarkRemoved();
+	}
+
+	bool Contains(uint32_t ordinal, DocumentStatus status) const {
+		return GetPartition(status).Contains(ordinal);
+	}
+
+	// The posting stays in the old partition marked removed, and one left there by an earlier move back is
+	// restored, so only a first move into a partition shifts postings, those after the new place.
+	bool Move(uint32_t ordinal, DocumentStatus from, DocumentStatus to) {
+		PostingList& source = partitions_[static_cast<size_t>(from)];
+		const auto it = source.LowerBound(ordinal);
+		if (it == source.end() || it->ordinal != ordinal) {
+			return false;
+		}
+		source.MarkRemoved();
+		PostingList& destination = partitions_[static_cast<size_t>(to)];
+		if (destination.Contains(ordinal)) {
+			destination.Restore();
+		} else {
+			destination.Add(ordinal, it->term_freq);
+		}
+		return true;
+	}
+
+	template <typename Predicate>
+	void Sweep(DocumentStatus status, Predicate is_removed) {
+		partitions_[static_cast<size_t>(status)].Sweep(is_removed);
+	}
+
+	void Remap(const std::vector<uint32_t>& new_ordinals) {
+		for (PostingList& partition : partitions_) {
+			partition.Remap(new_ordinals);
+		}
+	}
+
+	const PostingList& GetPartition(DocumentStatus status) const {
+		return partitions_[static_cast<size_t>(status)];
+	}
+
+	// Indexed by status.
+	const std::array<PostingList, DOCUMENT_STATUS_COUNT>& GetPartitions() const {
+		return partitions_;
+	}
+
+	// Live documents of every status: inverse document frequencies do not depend on the statuses searched.
+	size_t size() const {
+		size_t size = 0;
+		for (const PostingList& partition : partitions_) {
+			size += partition.size() - partition.GetRemovedCount();
+		}
+		return size;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	size_t GetMemoryUsage() const {
+		size_t bytes = 0;
+		for (const PostingList& partition : partitions_) {
+			bytes += partition.GetMemoryUsage();
+		}
+		return bytes;
+	}
+
+private:
+	static constexpr auto STATUSES = std::make_index_sequence<DOCUMENT_STATUS_COUNT>();
+
+	template <typename MakePartition, size_t... Statuses>
+	static std::array<PostingList, DOCUMENT_STATUS_COUNT> MakePartitions(MakePartition make_partition, std::index_sequence<Statuses...>) {
+		return {make_partition(Statuses)...};
+	}
+
+	std::array<PostingList, DOCUMENT_STATUS_COUNT> partitions_;
+};
+
+// Merges posting lists in ordinal order: every document comes out once, scored with the
+// weighted sum of its term frequencies over the lists that contain it.
+class PostingListUnion {
+public:
+	explicit PostingListUnion(const std::vector<std::pair<const PostingList*, double>>& weighted_lists) {
+		for (const auto& [list, weight] : weighted_lists) {
+			if (!list->empty()) {
+				cursors_.push_back({list->begin(), list->end(), weight});
+			}
+		}
+		std::make_heap(cursors_.begin(), cursors_.end(), IsAfter);
+	}
+
+	bool Next(uint32_t& ordinal, double& score) {
+		if (cursors_.empty()) {
+			return false;
+		}
+		ordinal = cursors_.front().current->ordinal;
+		score = 0.0;
+		while (!cursors_.empty() && cursors_.front().current->ordinal == ordinal) {
+			std::pop_heap(cursors_.begin(), cursors_.end(), IsAfter);
+			Cursor& cursor = cursors_.back();
+			score += cursor.current->term_freq * cursor.weight;
+			if (++cursor.current == cursor.end) {
+				cursors_.pop_back();
+			} else {
+				std::push_heap(cursors_.begin(), cursors_.end(), IsAfter);
+			}
+		}
+		return true;
+	}
+
+private:
+	struct Cursor {
+		PostingList::const_iterator current;
+		PostingList::const_iterator end;
+		double weight;
+	};
+
+	static bool IsAfter(const Cursor& lhs, const Cursor& rhs) {
+		return lhs.current->ordinal > rhs.current->ordinal;
+	}
+
+	std::vector<Cursor> cursors_;
+};
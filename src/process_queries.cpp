@@ -1,10 +1,7 @@
 #include "process_queries.h"
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
-	std::vector<std::vector<Document>> result(queries.size());
-	std::transform( std::make_move_iterator(queries.begin()), std::make_move_iterator(queries.end()), result.begin(),
-			[&search_server](const std::string& words){ return search_server.FindTopDocuments(words); });
-	return result;
+	return search_server.FindTopDocumentsBatch(queries);
 }
 
 //std::execution::par,
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "document.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class CancellationToken {
+public:
+	CancellationToken() = default;
+
+	bool IsCancelled() const {
+		return flag_ && flag_->load(std::memory_order_relaxed);
+	}
+
+private:
+	friend class CancellationSource;
+
+	explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> flag) : flag_(std::move(flag)) {
+	}
+
+	std::shared_ptr<const std::atomic<bool>> flag_;
+};
+
+class CancellationSource {
+public:
+	void Cancel() {
+		flag_->store(true, std::memory_order_relaxed);
+	}
+
+	CancellationToken GetToken() const {
+		return CancellationToken(flag_);
+	}
+
+private:
+	std::shared_ptr<std::atomic<bool>> flag_ = std::make_shared<std::atomic<bool>>(false);
+};
+
+// Deadline and cancellation of one query. Scoring asks IsExhausted() between blocks of
+// POSTING_BLOCK_SIZE postings and returns what it has found once the answer is yes.
+class QueryBudget {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr size_t POSTING_BLOCK_SIZE = 4096;
+
+	explicit QueryBudget(Clock::time_point deadline, CancellationToken token = {}) : deadline_(deadline), token_(std::move(token)) {
+	}
+
+	explicit QueryBudget(Clock::duration timeout, CancellationToken token = {}) : QueryBudget(Clock::now() + timeout, std::move(token)) {
+	}
+
+	bool IsExhausted() const {
+		if (!is_exhausted_) {
+			is_exhausted_ = token_.IsCancelled() || Clock::now() >= deadline_;
+		}
+		return is_exhausted_;
+	}
+
+	bool WasExhausted() const {
+		return is_exhausted_;
+	}
+
+private:
+	Clock::time_point deadline_;
+	CancellationToken token_;
+	mutable bool is_exhausted_ = false;
+};
+
+// Budget of ordinary queries; compiles down to no checks at all.
+struct UnlimitedBudget {
+	static constexpr size_t POSTING_BLOCK_SIZE = std::numeric_limits<size_t>::max();
+
+	constexpr bool IsExhausted() const {
+		return false;
+	}
+};
+
+struct SearchResult {
+	std::vector<Document> documents;
+	// The budget ran out before every posting was scored: documents are the best of those seen.
+	bool is_partial = false;
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "document.h"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// How a word took part in a query.
+enum class TermRole {
+	PLUS,
+	PREFIX_EXPANSION,
+	FUZZY_EXPANSION,
+	MINUS,
+};
+
+struct TermExplanation {
+	std::string word;
+	TermRole role = TermRole::PLUS;
+	// Inverse document frequency times the prefix or fuzzy weight; 0 for minus words.
+	double weight = 0.0;
+	size_t posting_count = 0;
+	// Fewer than posting_count when scoring skipped postings: conjunctive seeks, impact-order early exit.
+	size_t postings_read = 0;
+	// Documents first reached through this word and handed to the predicate, and how many it turned down.
+	size_t predicate_calls = 0;
+	size_t predicate_rejections = 0;
+	// Minus words: candidate documents dropped.
+	size_t excluded_documents = 0;
+	std::chrono::nanoseconds time{0};
+};
+
+struct StageExplanation {
+	std::string name;
+	// Candidate documents left after the stage.
+	size_t document_count = 0;
+	std::chrono::nanoseconds time{0};
+};
+
+struct QueryExplanation {
+	std::vector<Document> documents;
+	// Scoring path taken: "dense", "conjunctive" or "impact".
+	std::string path;
+	std::vector<TermExplanation> terms;
+	std::vector<StageExplanation> stages;
+};
+
+// Profiler of ordinary queries: every hook is empty, so the scoring loops compile exactly as without it.
+struct NullProfiler {
+	static constexpr bool IS_ENABLED = false;
+
+	constexpr void SetPath(std::string_view) const {
+	}
+
+	constexpr void StartTerm(std::string_view, TermRole, double, size_t) const {
+	}
+
+	constexpr void CountPostings(size_t) const {
+	}
+
+	constexpr void CountPredicate(bool) const {
+	}
+
+	constexpr void CountExcluded(size_t) const {
+	}
+
+	constexpr void EndTerm() const {
+	}
+
+	constexpr void EndStage(std::string_view, size_t) const {
+	}
+};
+
+// Records into a QueryExplanation. Counters go to the term started last; a stage lasts from the end of
+// the previous one. Single-threaded: explained queries run with the sequential policy.
+class QueryProfiler {
+public:
+	static constexpr bool IS_ENABLED = true;
+	using Clock = std::chrono::steady_clock;
+
+	explicit QueryProfiler(QueryExplanation& explanation) : explanation_(explanation) {
+	}
+
+	void SetPath(std::string_view path) const {
+		explanation_.path = path;
+	}
+
+	void StartTerm(std::string_view word, TermRole role, double weight, size_t posting_count) const {
+		explanation_.terms.push_back({std::string(word), role, weight, posting_count});
+		term_start_ = Clock::now();
+	}
+
+	void CountPostings(size_t count) const {
+		explanation_.terms.back().postings_read += count;
+	}
+
+	void CountPredicate(bool is_accepted) const {
+		++explanation_.terms.back().predicate_calls;
+		explanation_.terms.back().predicate_rejections += is_accepted ? 0 : 1;
+	}
+
+	void CountExcluded(size_t count) const {
+		explanation_.terms.back().excluded_documents += count;
+	}
+
+	void EndTerm() const {
+		explanation_.terms.back().time = Clock::now() - term_start_;
+	}
+
+	void EndStage(std::string_view name, size_t document_count) const {
+		const auto now = Clock::now();
+		explanation_.stages.push_back({std::string(name), document_count, now - stage_start_});
+		stage_start_ = now;
+	}
+
+private:
+	QueryExplanation& explanation_;
+	mutable Clock::time_point stage_start_ = Clock::now();
+	mutable Clock::time_point term_start_;
+};
+
+template <typename Stream>
+Stream& operator<<(Stream& out, const QueryExplanation& explanation) {
+	using namespace std;
+	static const char* const ROLE_NAMES[] = {"plus", "prefix", "fuzzy", "minus"};
+	out << "path: "s << explanation.path << ", documents: "s << explanation.documents.size() << '\n';
+	for (const StageExplanation& stage : explanation.stages) {
+		out << "  stage "s << stage.name << ": "s << stage.document_count << " documents, "s << stage.time.count() / 1000.0 << " us\n"s;
+	}
+	for (const TermExplanation& term : explanation.terms) {
+		out << "  "s << ROLE_NAMES[static_cast<int>(term.role)] << ' ' << term.word << ": weight "s << term.weight
+			<< ", postings "s << term.postings_read << '/' << term.posting_count
+			<< ", predicate "s << term.predicate_calls - term.predicate_rejections << '/' << term.predicate_calls
+			<< ", excluded "s << term.excluded_documents << ", "s << term.time.count() / 1000.0 << " us\n"s;
+	}
+	return out;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Dense per-document scores of the sequential scoring kernel, indexed by document ordinal.
+// Every document also remembers whether the query predicate accepted it, so the predicate runs
+// once per document rather than once per posting. Only touched slots are reset between queries,
+// so an instance can be reused and a query costs in proportion to the postings it reads.
+class ScoreAccumulator {
+public:
+	enum class State : uint8_t {
+		UNSEEN,
+		ACCEPTED,
+		REJECTED,
+	};
+
+	// Sizes the slots for document_count documents; call it between queries. Slots far past that are
+	// released, so an instance that once served a large index does not keep its memory.
+	void Reserve(size_t document_count) {
+		if (scores_.size() < document_count) {
+			scores_.resize(document_count, 0.0);
+			states_.resize(document_count, State::UNSEEN);
+		} else if (scores_.size() / SHRINK_FACTOR > document_count) {
+			std::vector<double>(document_count, 0.0).swap(scores_);
+			std::vector<State>(document_count, State::UNSEEN).swap(states_);
+			std::vector<uint32_t>().swap(touched_);
+		}
+	}
+
+	State GetState(uint32_t ordinal) const {
+		return states_[ordinal];
+	}
+
+	void SetState(uint32_t ordinal, State state) {
+		if (states_[ordinal] == State::UNSEEN) {
+			touched_.push_back(ordinal);
+		}
+		states_[ordinal] = state;
+	}
+
+	void Add(uint32_t ordinal, double value) {
+		scores_[ordinal] += value;
+	}
+
+	double GetScore(uint32_t ordinal) const {
+		return scores_[ordinal];
+	}
+
+	const std::vector<uint32_t>& GetTouched() const {
+		return touched_;
+	}
+
+	void Clear() {
+		for (const uint32_t ordinal : touched_) {
+			scores_[ordinal] = 0.0;
+			states_[ordinal] = State::UNSEEN;
+		}
+		touched_.clear();
+	}
+
+private:
+	// Growing back costs as much as the queries that needed the slots, so only a large surplus is released.
+	static constexpr size_t SHRINK_FACTOR = 4;
+
+	std::vector<double> scores_;
+	std::vector<State> states_;
+	std::vector<uint32_t> touched_;
+};
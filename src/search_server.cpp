@@ -2,39 +2,531 @@
 
 using namespace std;
 
-SearchServer::SearchServer(const string& stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {
+SearchServer::SearchServer(const string& stop_words_text, pmr::memory_resource* resource) : SearchServer(SplitIntoWords(stop_words_text), resource) {
 }
 
-SearchServer::SearchServer(string_view stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {
+SearchServer::SearchServer(string_view stop_words_text, pmr::memory_resource* resource) : SearchServer(SplitIntoWords(stop_words_text), resource) {
 }
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
-	if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+	if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
 		throw invalid_argument("Invalid document_id"s);
 	}
-	const auto words = SplitIntoWordsNoStop(document);
+	IndexDocument(document_id, document, ComputeTermFreqs(SplitIntoWordsNoStop(document)), status, ComputeAverageRating(ratings));
+}
+
+void SearchServer::AddDocumentConcurrently(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+	if (document_id < 0) {
+		throw invalid_argument("Invalid document_id"s);
+	}
+	StagedDocument staged{document_id, status, ComputeAverageRating(ratings), make_unique<string>(document), {}};
+	// Counted here rather than at merge time, which holds the index lock.
+	staged.term_freqs = ComputeTermFreqs(SplitIntoWordsNoStop(*staged.text));
+	{
+		auto reserved = ingest_->reserved_ids[document_id];
+		if (reserved.ref_to_value) {
+			throw invalid_argument("Invalid document_id"s);
+		}
+		reserved.ref_to_value = true;
+	}
+	bool is_indexed;
+	{
+		shared_lock lock(ingest_->index_mutex);
+		is_indexed = document_ordinals_.count(document_id) > 0;
+	}
+	if (is_indexed) {
+		ingest_->reserved_ids.Erase(document_id);
+		throw invalid_argument("Invalid document_id"s);
+	}
+	IngestStripe& stripe = ingest_->stripes[hash<thread::id>{}(this_thread::get_id()) % INGEST_STRIPE_COUNT];
+	vector<StagedDocument> batch;
+	{
+		lock_guard lock(stripe.mutex);
+		stripe.documents.push_back(move(staged));
+		if (stripe.documents.size() >= INGEST_BATCH_SIZE) {
+			batch.swap(stripe.documents);
+		}
+	}
+	MergeStagedDocuments(batch);
+}
+
+vector<int> SearchServer::FlushIngest() {
+	for (IngestStripe& stripe : ingest_->stripes) {
+		vector<StagedDocument> batch;
+		{
+			lock_guard lock(stripe.mutex);
+			batch.swap(stripe.documents);
+		}
+		MergeStagedDocuments(batch);
+	}
+	unique_lock lock(ingest_->index_mutex);
+	vector<int> dropped_ids;
+	dropped_ids.swap(ingest_->dropped_ids);
+	return dropped_ids;
+}
+
+void SearchServer::MergeStagedDocuments(vector<StagedDocument>& documents) {
+	if (documents.empty()) {
+		return;
+	}
+	vector<StagedPosting> postings;
+	{
+		unique_lock lock(ingest_->index_mutex);
+		for (const StagedDocument& document : documents) {
+			// A duplicate dropped under REJECT or KEEP_OLDEST: its producer has returned long ago, so the id is
+			// reported by FlushIngest.
+			try {
+				if (!IndexDocument(document.id, *document.text, document.term_freqs, document.status, document.rating, &postings)) {
+					ingest_->dropped_ids.push_back(document.id);
+				}
+			} catch (const invalid_argument&) {
+				ingest_->dropped_ids.push_back(document.id);
+			}
+			ingest_->reserved_ids.Erase(document.id);
+		}
+	}
+	// Postings keep their ordinal order within a shard, so most of them are appended at the end of their lists.
+	vector<size_t> shards(postings.size());
+	for (size_t i = 0; i < postings.size(); ++i) {
+		shards[i] = hash<string_view>{}(postings[i].word->first) % INGEST_TERM_SHARD_COUNT;
+	}
+	vector<size_t> order(postings.size());
+	iota(order.begin(), order.end(), size_t{0});
+	stable_sort(order.begin(), order.end(), [&shards](size_t lhs, size_t rhs) {
+		return shards[lhs] < shards[rhs];
+	});
+	shared_lock lock(ingest_->index_mutex);
+	// Merges from different threads start on different shards instead of queueing behind each other.
+	const size_t first_shard = hash<thread::id>{}(this_thread::get_id()) % INGEST_TERM_SHARD_COUNT;
+	for (size_t step = 0; step < INGEST_TERM_SHARD_COUNT; ++step) {
+		const size_t shard = (first_shard + step) % INGEST_TERM_SHARD_COUNT;
+		auto it = lower_bound(order.begin(), order.end(), shard, [&shards](size_t index, size_t value) {
+			return shards[index] < value;
+		});
+		if (it == order.end() || shards[*it] != shard) {
+			continue;
+		}
+		lock_guard shard_lock(ingest_->term_shards[shard]);
+		for (; it != order.end() && shards[*it] == shard; ++it) {
+			const StagedPosting& posting = postings[*it];
+			posting.word->second.Add(posting.ordinal, posting.status, posting.term_freq);
+			InsertImpactPosting(posting.word->first, {posting.ordinal, posting.term_freq}, posting.status);
+		}
+	}
+}
+
+SearchServer::TermFreqs SearchServer::ComputeTermFreqs(vector<string_view> words) {
 	const double inv_word_count = 1.0 / words.size();
-	for (string_view word : words) {
-		string word_collected{word.begin(), word.end()};
-		word_to_document_freqs_[word_collected][document_id] += inv_word_count;
-		document_to_word_freqs_[document_id][word_to_document_freqs_.find(word_collected)->first] += inv_word_count;
+	sort(words.begin(), words.end());
+	TermFreqs term_freqs;
+	for (const string_view word : words) {
+		if (term_freqs.empty() || term_freqs.back().first != word) {
+			term_freqs.emplace_back(word, 0.0);
+		}
+		// Added one occurrence at a time, so a frequency does not depend on where the document was counted.
+		term_freqs.back().second += inv_word_count;
+	}
+	return term_freqs;
+}
+
+bool SearchServer::IndexDocument(int document_id, string_view document, const TermFreqs& term_freqs, DocumentStatus status, int rating,
+		vector<StagedPosting>* staged_postings) {
+	uint64_t fingerprint = 0;
+	if (duplicate_policy_) {
+		vector<string_view> distinct_words;
+		distinct_words.reserve(term_freqs.size());
+		for (const auto& [word, term_freq] : term_freqs) {
+			distinct_words.push_back(word);
+		}
+		fingerprint = ComputeFingerprint(distinct_words);
+		if (const auto original_id = FindDuplicate(fingerprint, distinct_words)) {
+			if (on_duplicate_) {
+				on_duplicate_(document_id, *original_id);
+			}
+			if (*duplicate_policy_ == DuplicatePolicy::REJECT) {
+				throw invalid_argument("Duplicate of document "s + to_string(*original_id));
+			}
+			if (*duplicate_policy_ == DuplicatePolicy::KEEP_OLDEST) {
+				return false;
+			}
+		}
+	}
+	// New documents get the next ordinal, so postings are always appended at the end of their lists.
+	const uint32_t ordinal = static_cast<uint32_t>(documents_.size());
+	auto& word_freqs = document_to_word_freqs_[document_id];
+	for (const auto& [word, term_freq] : term_freqs) {
+		const auto* indexed = word_index_.Find(word);
+		auto postings = indexed ? *indexed : word_to_document_freqs_.end();
+		if (postings == word_to_document_freqs_.end()) {
+			postings = word_to_document_freqs_.emplace(StoreWord(word), PartitionedPostingList()).first;
+			word_index_.Insert(postings->first, postings);
+			term_dictionary_.Insert(postings->first);
+		}
+		// term_freqs is in byte order, like the map.
+		word_freqs.emplace_hint(word_freqs.end(), postings->first, term_freq);
+		if (staged_postings) {
+			staged_postings->push_back({postings, ordinal, status, term_freq});
+		} else {
+			postings->second.Add(ordinal, status, term_freq);
+		}
+	}
+	if (positional_index_) {
+		map<string_view, vector<uint32_t>> word_positions;
+		uint32_t position = 0;
+		for (string_view word : SplitIntoWords(document)) {
+			if (!IsStopWord(word)) {
+				word_positions[FindWord(word)->first].push_back(position);
+			}
+			++position;
+		}
+		for (const auto& [word, positions] : word_positions) {
+			positional_index_->Add(word, ordinal, positions);
+		}
 	}
-	documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+	documents_.push_back({document_id, rating, status});
+	// After documents_: impact order compares ratings and ids.
+	if (!impact_postings_.empty() && !staged_postings) {
+		for (const auto [word, term_freq] : word_freqs) {
+			InsertImpactPosting(word, {ordinal, term_freq}, status);
+		}
+	}
+	document_ordinals_.emplace(document_id, ordinal);
 	document_ids_.insert(document_id);
+	if (duplicate_policy_) {
+		fingerprint_documents_.emplace(fingerprint, document_id);
+	}
+	return true;
+}
+
+void SearchServer::EnableDuplicateDetection(DuplicatePolicy policy, function<void(int, int)> on_duplicate) {
+	if (!duplicate_policy_) {
+		for (const int document_id : document_ids_) {
+			fingerprint_documents_.emplace(ComputeFingerprint(GetDocumentWords(document_id)), document_id);
+		}
+	}
+	duplicate_policy_ = policy;
+	on_duplicate_ = move(on_duplicate);
+}
+
+uint64_t SearchServer::ComputeFingerprint(const vector<string_view>& sorted_words) {
+	uint64_t fingerprint = 14695981039346656037ull;
+	for (const string_view word : sorted_words) {
+		fingerprint = (fingerprint ^ hash<string_view>{}(word)) * 1099511628211ull;
+	}
+	return fingerprint;
+}
+
+vector<string_view> SearchServer::GetDocumentWords(int document_id) const {
+	// Map keys are already sorted and unique.
+	vector<string_view> words;
+	for (const auto& [word, _] : document_to_word_freqs_.at(document_id)) {
+		words.push_back(word);
+	}
+	return words;
+}
+
+optional<int> SearchServer::FindDuplicate(uint64_t fingerprint, const vector<string_view>& sorted_words) const {
+	const auto [first, last] = fingerprint_documents_.equal_range(fingerprint);
+	for (auto it = first; it != last; ++it) {
+		const auto& word_freqs = document_to_word_freqs_.at(it->second);
+		if (word_freqs.size() == sorted_words.size() && equal(sorted_words.begin(), sorted_words.end(), word_freqs.begin(),
+				[](string_view word, const auto& word_freq) { return word == word_freq.first; })) {
+			return it->second;
+		}
+	}
+	return nullopt;
+}
+
+void SearchServer::EraseFingerprint(int document_id) {
+	const auto [first, last] = fingerprint_documents_.equal_range(ComputeFingerprint(GetDocumentWords(document_id)));
+	for (auto it = first; it != last; ++it) {
+		if (it->second == document_id) {
+			fingerprint_documents_.erase(it);
+			return;
+		}
+	}
+}
+
+void SearchServer::EnablePositionalIndex() {
+	if (!document_ids_.empty()) {
+		throw logic_error("Positional index must be enabled before documents are added"s);
+	}
+	if (!positional_index_) {
+		positional_index_ = make_unique<PositionalIndex>(&resources_->positions);
+	}
+}
+
+void SearchServer::ReorderDocuments() {
+	vector<uint32_t> old_ordinals;
+	for (const auto [document_id, ordinal] : document_ordinals_) {
+		old_ordinals.push_back(ordinal);
+	}
+	sort(old_ordinals.begin(), old_ordinals.end());
+	vector<uint32_t> live_indexes(documents_.size());
+	for (uint32_t i = 0; i < old_ordinals.size(); ++i) {
+		live_indexes[old_ordinals[i]] = i;
+	}
+	// Words are numbered and visited in dictionary order, so every term list stays sorted.
+	vector<vector<uint32_t>> document_terms(old_ordinals.size());
+	uint32_t term = 0;
+	for (const auto& [word, postings] : word_to_document_freqs_) {
+		for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+			for (const Posting& posting : postings.GetPartitions()[status]) {
+				if (!IsRemovedPosting(posting.ordinal, static_cast<DocumentStatus>(status))) {
+					document_terms[live_indexes[posting.ordinal]].push_back(term);
+				}
+			}
+		}
+		++term;
+	}
+	const vector<uint32_t> order = ComputeBisectionOrder(document_terms, word_to_document_freqs_.size());
+	vector<uint32_t> new_order;
+	new_order.reserve(order.size());
+	for (const uint32_t index : order) {
+		new_order.push_back(old_ordinals[index]);
+	}
+	RenumberDocuments(new_order);
+}
+
+void SearchServer::RenumberDocuments(const vector<uint32_t>& old_ordinals) {
+	vector<uint32_t> new_ordinals(documents_.size(), PostingList::DROPPED);
+	pmr::vector<DocumentData> documents(documents_.get_allocator());
+	documents.reserve(old_ordinals.size());
+	for (const uint32_t old_ordinal : old_ordinals) {
+		new_ordinals[old_ordinal] = static_cast<uint32_t>(documents.size());
+		document_ordinals_[documents_[old_ordinal].id] = new_ordinals[old_ordinal];
+		documents.push_back(documents_[old_ordinal]);
+	}
+	for (auto& [word, postings] : word_to_document_freqs_) {
+		for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+			if (postings.GetPartitions()[status].GetRemovedCount() > 0) {
+				postings.Sweep(static_cast<DocumentStatus>(status), [this, status](uint32_t ordinal) {
+					return IsRemovedPosting(ordinal, static_cast<DocumentStatus>(status));
+				});
+			}
+		}
+		postings.Remap(new_ordinals);
+	}
+	documents_ = move(documents);
+	// Impact order does not depend on ordinals. Postings of removed documents and of documents now in
+	// another partition are dropped, and the tail is merged.
+	for (auto& [key, impact_postings] : impact_postings_) {
+		auto& [main, tail] = impact_postings;
+		const DocumentStatus status = key.second;
+		main.insert(main.end(), tail.begin(), tail.end());
+		tail.clear();
+		for (Posting& posting : main) {
+			posting.ordinal = new_ordinals[posting.ordinal];
+		}
+		main.erase(remove_if(main.begin(), main.end(), [this, status](const Posting& posting) {
+			return posting.ordinal == PostingList::DROPPED || documents_[posting.ordinal].status != status;
+		}), main.end());
+		sort(main.begin(), main.end(), [this](const Posting& lhs, const Posting& rhs) {
+			return IsImpactBefore(lhs, rhs);
+		});
+	}
+	if (positional_index_) {
+		positional_index_->Remap(new_ordinals);
+	}
+}
+
+void SearchServer::CompactDocuments() {
+	const size_t removed_count = documents_.size() - document_ordinals_.size();
+	if (removed_count < COMPACTION_MIN_REMOVED || removed_count <= document_ordinals_.size()) {
+		return;
+	}
+	vector<uint32_t> old_ordinals;
+	old_ordinals.reserve(document_ordinals_.size());
+	for (const auto [document_id, ordinal] : document_ordinals_) {
+		old_ordinals.push_back(ordinal);
+	}
+	// Live documents keep their relative order.
+	sort(old_ordinals.begin(), old_ordinals.end());
+	RenumberDocuments(old_ordinals);
+}
+
+void SearchServer::BuildImpactOrder(size_t min_posting_count) {
+	impact_postings_.clear();
+	for (const auto& [word, postings] : word_to_document_freqs_) {
+		if (postings.empty() || postings.size() < min_posting_count) {
+			continue;
+		}
+		// Empty partitions get a copy too, so that documents moving into them keep it up to date.
+		for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+			const PostingList& partition = postings.GetPartitions()[status];
+			auto& impact_postings = impact_postings_.try_emplace({word, static_cast<DocumentStatus>(status)}).first->second.main;
+			copy_if(partition.begin(), partition.end(), back_inserter(impact_postings), [this, status](const Posting& posting) {
+				return !IsRemovedPosting(posting.ordinal, static_cast<DocumentStatus>(status));
+			});
+			sort(impact_postings.begin(), impact_postings.end(), [this](const Posting& lhs, const Posting& rhs) {
+				return IsImpactBefore(lhs, rhs);
+			});
+		}
+	}
+}
+
+bool SearchServer::IsRemovedPosting(uint32_t ordinal, DocumentStatus status) const {
+	const DocumentData& document_data = documents_[ordinal];
+	return document_data.is_removed || document_data.status != status;
+}
+
+bool SearchServer::IsImpactBefore(const Posting& lhs, const Posting& rhs) const {
+	if (lhs.term_freq != rhs.term_freq) {
+		return lhs.term_freq > rhs.term_freq;
+	}
+	const DocumentData& lhs_data = documents_[lhs.ordinal];
+	const DocumentData& rhs_data = documents_[rhs.ordinal];
+	if (lhs_data.rating != rhs_data.rating) {
+		return lhs_data.rating > rhs_data.rating;
+	}
+	return lhs_data.id < rhs_data.id;
+}
+
+void SearchServer::SetFuzzyMatching(int max_edits, double penalty) {
+	if (max_edits < 0 || max_edits > 2 || !(penalty > 0.0 && penalty <= 1.0)) {
+		throw invalid_argument("Fuzzy matching needs 0-2 edits and a penalty in (0, 1]"s);
+	}
+	fuzzy_max_edits_ = max_edits;
+	fuzzy_penalty_ = penalty;
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-	return FindTopDocuments(std::execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-		return document_status == status;
-	});
+	return FindTopDocuments(std::execution::seq, raw_query, DocumentStatusPredicate{status});
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
 	return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries, DocumentStatus status) const {
+	const DocumentStatusPredicate document_predicate{status};
+	vector<Query> queries;
+	queries.reserve(raw_queries.size());
+	for (const string& raw_query : raw_queries) {
+		queries.push_back(ParseQuery(raw_query));
+	}
+	vector<vector<Document>> results(queries.size());
+	vector<ScoreAccumulator> accumulators;
+	for (size_t chunk_begin = 0; chunk_begin < queries.size(); chunk_begin += BATCH_QUERY_COUNT) {
+		const size_t chunk_end = min(queries.size(), chunk_begin + BATCH_QUERY_COUNT);
+		// Scored word -> chunk indexes of the queries scoring it with their weights, once per occurrence in the query.
+		map<string_view, pair<const PartitionedPostingList*, vector<pair<size_t, double>>>> word_queries;
+		vector<bool> is_shared(chunk_end - chunk_begin, false);
+		for (size_t i = chunk_begin; i < chunk_end; ++i) {
+			if (!queries[i].required_words.empty() || HasPositionalConstraints(queries[i])) {
+				results[i] = FindAllDocuments(execution::seq, queries[i], document_predicate);
+				SelectTopDocuments(results[i], MAX_RESULT_DOCUMENT_COUNT);
+				continue;
+			}
+			is_shared[i - chunk_begin] = true;
+			for (const ScoredWord& scored_word : queries[i].scored_words) {
+				auto& [postings, query_weights] = word_queries[scored_word.word->first];
+				postings = &scored_word.word->second;
+				query_weights.emplace_back(i - chunk_begin, scored_word.weight);
+			}
+		}
+		// Scores go into one dense accumulator per query, over a window of ordinals small enough for all of
+		// them to stay in memory together. Every posting list is still read once, its cursor carried from
+		// window to window, and within a window contributions reach each query in word order, as in the
+		// single-query kernel.
+		const size_t window_size = max(BATCH_SCORE_SLOTS / (chunk_end - chunk_begin), size_t{1});
+		accumulators.resize(max(accumulators.size(), chunk_end - chunk_begin));
+		vector<ScoredDocuments> scored_documents(chunk_end - chunk_begin);
+		struct WordScan {
+			PostingList::const_iterator posting;
+			PostingList::const_iterator end;
+			vector<pair<size_t, double>> query_inverse_document_freqs;
+		};
+		vector<WordScan> scans;
+		for (const auto& [word, word_query] : word_queries) {
+			const auto& [postings, query_weights] = word_query;
+			const double inverse_document_freq = ComputeInverseDocumentFreq(postings->size());
+			WordScan& scan = scans.emplace_back();
+			scan.posting = postings->GetPartition(status).begin();
+			scan.end = postings->GetPartition(status).end();
+			for (const auto& [query_index, weight] : query_weights) {
+				scan.query_inverse_document_freqs.emplace_back(query_index, inverse_document_freq * weight);
+			}
+		}
+		for (size_t window_begin = 0; window_begin < documents_.size() && !scans.empty(); window_begin += window_size) {
+			const size_t window_end = min(documents_.size(), window_begin + window_size);
+			for (size_t i = chunk_begin; i < chunk_end; ++i) {
+				accumulators[i - chunk_begin].Reserve(window_end - window_begin);
+			}
+			for (WordScan& scan : scans) {
+				for (; scan.posting != scan.end && scan.posting->ordinal < window_end; ++scan.posting) {
+					const uint32_t slot = static_cast<uint32_t>(scan.posting->ordinal - window_begin);
+					for (const auto& [query_index, query_inverse_document_freq] : scan.query_inverse_document_freqs) {
+						ScoreAccumulator& accumulator = accumulators[query_index];
+						accumulator.SetState(slot, ScoreAccumulator::State::ACCEPTED);
+						accumulator.Add(slot, scan.posting->term_freq * query_inverse_document_freq);
+					}
+				}
+			}
+			scans.erase(remove_if(scans.begin(), scans.end(), [](const WordScan& scan) {
+				return scan.posting == scan.end;
+			}), scans.end());
+			for (size_t i = chunk_begin; i < chunk_end; ++i) {
+				ScoreAccumulator& accumulator = accumulators[i - chunk_begin];
+				vector<uint32_t> slots = accumulator.GetTouched();
+				sort(slots.begin(), slots.end());
+				for (const uint32_t slot : slots) {
+					if (!IsRemovedPosting(static_cast<uint32_t>(window_begin + slot), status)) {
+						scored_documents[i - chunk_begin].emplace_back(static_cast<uint32_t>(window_begin + slot), accumulator.GetScore(slot));
+					}
+				}
+				accumulator.Clear();
+			}
+		}
+		for (size_t i = chunk_begin; i < chunk_end; ++i) {
+			if (!is_shared[i - chunk_begin]) {
+				continue;
+			}
+			ExcludeMinusWords(queries[i], scored_documents[i - chunk_begin]);
+			for (const auto& [ordinal, relevance] : scored_documents[i - chunk_begin]) {
+				results[i].push_back({documents_[ordinal].id, relevance, documents_[ordinal].rating});
+			}
+			SelectTopDocuments(results[i], MAX_RESULT_DOCUMENT_COUNT);
+			ScoredDocuments().swap(scored_documents[i - chunk_begin]);
+		}
+	}
+	return results;
+}
+
+SearchResult SearchServer::FindTopDocumentsWithin(string_view raw_query, const QueryBudget& budget, DocumentStatus status) const {
+	return FindTopDocumentsWithin(raw_query, budget, DocumentStatusPredicate{status});
+}
+
+SearchResult SearchServer::FindTopDocumentsWithin(string_view raw_query, const QueryBudget& budget) const {
+	return FindTopDocumentsWithin(raw_query, budget, DocumentStatus::ACTUAL);
+}
+
+QueryExplanation SearchServer::ExplainTopDocuments(string_view raw_query, DocumentStatus status) const {
+	return ExplainTopDocuments(raw_query, DocumentStatusPredicate{status});
+}
+
+QueryExplanation SearchServer::ExplainTopDocuments(string_view raw_query) const {
+	return ExplainTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+future<SearchResult> SearchServer::FindTopDocumentsAsync(string raw_query, QueryBudget budget, DocumentStatus status) const {
+	return FindTopDocumentsAsync(move(raw_query), move(budget), DocumentStatusPredicate{status});
+}
+
+future<SearchResult> SearchServer::FindTopDocumentsAsync(string raw_query, QueryBudget budget) const {
+	return FindTopDocumentsAsync(move(raw_query), move(budget), DocumentStatus::ACTUAL);
+}
+
+vector<Document> SearchServer::FindTopDocumentsAfter(string_view raw_query, const optional<Document>& last, size_t page_size, DocumentStatus status) const {
+	return FindTopDocumentsAfter(std::execution::seq, raw_query, last, page_size, status);
+}
+
+vector<Document> SearchServer::FindTopDocumentsAfter(string_view raw_query, const optional<Document>& last, size_t page_size) const {
+	return FindTopDocumentsAfter(std::execution::seq, raw_query, last, page_size, DocumentStatus::ACTUAL);
+}
+
 int SearchServer::GetDocumentCount() const {
-	return documents_.size();
+	return document_ids_.size();
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
@@ -70,18 +562,107 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_vi
 	return {matched_words, documents_.at(document_id).status};*/
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
+const pmr::map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
 	return document_to_word_freqs_.at(document_id);
 }
 
+MemoryStats SearchServer::GetMemoryStats() const {
+	MemoryStats stats;
+	stats.stop_words = resources_->stop_words.GetAllocatedBytes();
+	stats.word_to_document_freqs = resources_->word_to_document_freqs.GetAllocatedBytes();
+	stats.word_index = resources_->word_index.GetAllocatedBytes();
+	stats.document_to_word_freqs = resources_->document_to_word_freqs.GetAllocatedBytes();
+	stats.documents = resources_->documents.GetAllocatedBytes();
+	stats.document_ordinals = resources_->document_ordinals.GetAllocatedBytes();
+	stats.fingerprints = resources_->fingerprints.GetAllocatedBytes();
+	stats.document_ids = resources_->document_ids.GetAllocatedBytes();
+	stats.positions = resources_->positions.GetAllocatedBytes();
+	stats.impact_postings = resources_->impact_postings.GetAllocatedBytes();
+	stats.term_dictionary = resources_->term_dictionary.GetAllocatedBytes();
+	stats.words = resources_->words.GetAllocatedBytes();
+	stats.word_arena_slack = stats.words - stored_word_bytes_;
+	for (const CountingResource* resource : {&resources_->stop_words, &resources_->word_to_document_freqs, &resources_->word_index, &resources_->document_to_word_freqs,
+			&resources_->documents, &resources_->document_ordinals, &resources_->fingerprints, &resources_->document_ids, &resources_->positions, &resources_->impact_postings, &resources_->term_dictionary, &resources_->words}) {
+		stats.allocation_count += resource->GetAllocationCount();
+	}
+	return stats;
+}
+
+TermMemory SearchServer::GetTermMemory(string_view word) const {
+	const auto postings = FindWord(word);
+	if (postings == word_to_document_freqs_.end()) {
+		return {};
+	}
+	TermMemory memory{postings->first, postings->second.size(), postings->second.GetMemoryUsage()};
+	for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+		if (const auto impact = impact_postings_.find({postings->first, static_cast<DocumentStatus>(status)}); impact != impact_postings_.end()) {
+			memory.bytes += (impact->second.main.capacity() + impact->second.tail.capacity()) * sizeof(Posting);
+		}
+	}
+	if (positional_index_) {
+		memory.bytes += positional_index_->GetMemoryUsage(postings->first);
+	}
+	return memory;
+}
+
+vector<TermMemory> SearchServer::GetLargestTerms(size_t count) const {
+	const auto is_larger = [](const TermMemory& lhs, const TermMemory& rhs) {
+		return lhs.bytes > rhs.bytes || (lhs.bytes == rhs.bytes && lhs.word < rhs.word);
+	};
+	// Min-heap of the largest terms so far: the dictionary is walked once without copying it.
+	vector<TermMemory> largest;
+	if (count == 0) {
+		return largest;
+	}
+	for (const auto& [word, _] : word_to_document_freqs_) {
+		const TermMemory memory = GetTermMemory(word);
+		if (largest.size() < count) {
+			largest.push_back(memory);
+			push_heap(largest.begin(), largest.end(), is_larger);
+		} else if (is_larger(memory, largest.front())) {
+			pop_heap(largest.begin(), largest.end(), is_larger);
+			largest.back() = memory;
+			push_heap(largest.begin(), largest.end(), is_larger);
+		}
+	}
+	sort_heap(largest.begin(), largest.end(), is_larger);
+	return largest;
+}
+
 void SearchServer::RemoveDocument(int document_id) {
 	RemoveDocument(std::execution::seq, document_id);
 }
 
+void SearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+	if (!document_ids_.count(document_id)) {
+		throw out_of_range("invalid id");
+	}
+	const uint32_t ordinal = document_ordinals_.at(document_id);
+	DocumentData& document_data = documents_[ordinal];
+	const DocumentStatus old_status = document_data.status;
+	if (old_status == status) {
+		return;
+	}
+	document_data.status = status;
+	for (const auto& [word, term_freq] : document_to_word_freqs_.at(document_id)) {
+		PartitionedPostingList& postings = (*word_index_.Find(word))->second;
+		postings.Move(ordinal, old_status, status);
+		// Once the postings marked removed outnumber the live ones, dropping them costs no more than the
+		// moves that left them.
+		const PostingList& source = postings.GetPartition(old_status);
+		if (source.GetRemovedCount() * 2 > source.size()) {
+			postings.Sweep(old_status, [this, old_status](uint32_t ordinal) {
+				return IsRemovedPosting(ordinal, old_status);
+			});
+		}
+		InsertImpactPosting(word, {ordinal, term_freq}, status);
+	}
+}
+
 //   -----------------------private-----------------------
 
 bool SearchServer::IsStopWord(string_view word) const {
-	return stop_words_.count({word.begin(), word.end()}) > 0;
+	return stop_word_table_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(string_view word) {
@@ -101,6 +682,24 @@ vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
     return words;
 }
 
+string_view SearchServer::StoreWord(string_view word) {
+	if (word.empty()) {
+		return {};
+	}
+	char* data = static_cast<char*>(resources_->word_arena.allocate(word.size(), 1));
+	stored_word_bytes_ += word.size();
+	copy(word.begin(), word.end(), data);
+	return {data, word.size()};
+}
+
+pmr::set<pmr::string, less<>> SearchServer::MakeStopWords(const set<string>& stop_words, pmr::memory_resource* resource) {
+	pmr::set<pmr::string, less<>> result(resource);
+	for (const string& word : stop_words) {
+		result.emplace(word);
+	}
+	return result;
+}
+
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
 	if (ratings.empty()) {
 		return 0;
@@ -118,27 +717,69 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
 	}
 	string_view word = text;
 	bool is_minus = false;
+	bool is_required = false;
 	if (word[0] == '-') {
 		is_minus = true;
 		word = word.substr(1);
+	} else if (word[0] == '+') {
+		is_required = true;
+		word = word.substr(1);
 	}
-	if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+	bool is_prefix = false;
+	if (!word.empty() && word.back() == '*') {
+		is_prefix = true;
+		word.remove_suffix(1);
+	}
+	if (word.empty() || word[0] == '-' || word[0] == '+' || (is_required && is_prefix) || !IsValidWord(word)) {
 		string collected_text{text.begin(), text.end()};
 		throw invalid_argument("Query word "s + collected_text + " is invalid");
 	}
-	return {word, is_minus, IsStopWord(word)};
+	return {word, is_minus, !is_prefix && IsStopWord(word), is_prefix, is_required};
+}
+
+SearchServer::Query SearchServer::ParseQuery(string_view text) const {
+	Query query = ParseQueryWords(text);
+	ExpandQuery(query);
+	return query;
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
+SearchServer::Query SearchServer::ParseQueryWords(string_view text) const {
 	Query result;
-	for (string_view word : SplitIntoWords(text)) {
-		const auto query_word = ParseQueryWord(word);
-		if (!query_word.is_stop) {
+	const vector<string_view> words = SplitIntoWords(text);
+	for (size_t i = 0; i < words.size(); ++i) {
+		if (!words[i].empty() && words[i][0] == '"') {
+			i = ParsePhrase(words, i, result);
+			continue;
+		}
+		if (const auto max_distance = ParseProximityOperator(words[i])) {
+			if (i == 0 || i + 1 == words.size() || ParseProximityOperator(words[i - 1]) || ParseProximityOperator(words[i + 1])
+					|| (!words[i - 1].empty() && words[i - 1].back() == '"') || (!words[i + 1].empty() && words[i + 1][0] == '"')) {
+				throw invalid_argument("NEAR operator needs a single word on each side"s);
+			}
+			const auto left = ParseQueryWord(words[i - 1]);
+			const auto right = ParseQueryWord(words[i + 1]);
+			if (left.is_minus || right.is_minus || left.is_prefix || right.is_prefix) {
+				throw invalid_argument("NEAR operator can not be applied to minus or prefix words"s);
+			}
+			if (!left.is_stop && !right.is_stop) {
+				result.proximities.push_back({string(left.data), string(right.data), *max_distance});
+			}
+			continue;
+		}
+		const auto query_word = ParseQueryWord(words[i]);
+		if (query_word.is_prefix) {
+			(query_word.is_minus ? result.minus_prefixes : result.plus_prefixes).emplace(query_word.data);
+		} else if (!query_word.is_stop) {
 			if (query_word.is_minus) {
 				string collected_word{query_word.data.begin(), query_word.data.end()};
 				result.minus_words.insert(move(collected_word));
 			} else {
 				string collected_word{query_word.data.begin(), query_word.data.end()};
+				if (query_word.is_required) {
+					result.required_words.insert(collected_word);
+				} else if (fuzzy_max_edits_ > 0) {
+					result.fuzzy_words.insert(collected_word);
+				}
 				result.plus_words.insert(move(collected_word));
 			}
 		}
@@ -146,6 +787,353 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
 	return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string& word) const {
-	return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+bool SearchServer::IsRankedBefore(const Document& lhs, const Document& rhs) {
+	if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EPSILON) {
+		if (lhs.rating != rhs.rating) {
+			return lhs.rating > rhs.rating;
+		}
+		return lhs.id < rhs.id;
+	}
+	return lhs.relevance > rhs.relevance;
+}
+
+void SearchServer::SelectTopDocuments(vector<Document>& documents, size_t count) {
+	if (documents.size() > count) {
+		partial_sort(documents.begin(), documents.begin() + count, documents.end(), IsRankedBefore);
+		documents.resize(count);
+	} else {
+		sort(documents.begin(), documents.end(), IsRankedBefore);
+	}
+}
+
+size_t SearchServer::ParsePhrase(const vector<string_view>& words, size_t first, Query& query) const {
+	vector<string_view> phrase_words;
+	size_t last = first;
+	string_view word = words[first].substr(1);
+	while (true) {
+		const bool is_closed = !word.empty() && word.back() == '"';
+		if (is_closed) {
+			word.remove_suffix(1);
+		}
+		phrase_words.push_back(word);
+		if (is_closed) {
+			break;
+		}
+		if (++last == words.size()) {
+			throw invalid_argument("Phrase is not closed"s);
+		}
+		word = words[last];
+	}
+	Phrase phrase;
+	for (uint32_t offset = 0; offset < phrase_words.size(); ++offset) {
+		const auto query_word = ParseQueryWord(phrase_words[offset]);
+		if (query_word.is_minus || query_word.is_prefix || query_word.is_required) {
+			throw invalid_argument("Only plain words are allowed inside a phrase"s);
+		}
+		if (!query_word.is_stop) {
+			query.plus_words.emplace(query_word.data);
+			phrase.words.emplace_back(string(query_word.data), offset);
+		}
+	}
+	if (phrase.words.size() > 1) {
+		query.phrases.push_back(move(phrase));
+	}
+	return last;
+}
+
+optional<uint32_t> SearchServer::ParseProximityOperator(string_view word) {
+	const string_view prefix = "NEAR/"sv;
+	if (word.size() <= prefix.size() || word.substr(0, prefix.size()) != prefix) {
+		return nullopt;
+	}
+	uint32_t max_distance = 0;
+	for (const char c : word.substr(prefix.size())) {
+		if (c < '0' || c > '9') {
+			return nullopt;
+		}
+		max_distance = max_distance * 10 + static_cast<uint32_t>(c - '0');
+	}
+	return max_distance;
+}
+
+bool SearchServer::HasPositionalConstraints(const Query& query) {
+	return !query.phrases.empty() || !query.proximities.empty();
+}
+
+vector<SearchServer::WordToDocumentFreqs::const_iterator> SearchServer::FindPlusWords(const Query& query, bool rarest_first) const {
+	vector<WordToDocumentFreqs::const_iterator> plus_words;
+	for (const string_view word : query.plus_words) {
+		const auto postings = FindWord(word);
+		if (postings != word_to_document_freqs_.end()) {
+			plus_words.push_back(postings);
+		}
+	}
+	if (rarest_first) {
+		// Rare words carry the most relevance: score them first so that a cut-off query keeps the best part.
+		stable_sort(plus_words.begin(), plus_words.end(), [](const auto lhs, const auto rhs) {
+			return lhs->second.size() < rhs->second.size();
+		});
+	}
+	return plus_words;
+}
+
+vector<pair<SearchServer::WordToDocumentFreqs::const_iterator, int>> SearchServer::ExpandFuzzy(string_view word) const {
+	vector<pair<WordToDocumentFreqs::const_iterator, int>> similar_words;
+	const int max_edits = min(fuzzy_max_edits_, word.size() < 3 ? 0 : word.size() < 6 ? 1 : 2);
+	if (max_edits == 0 || word.size() > LevenshteinAutomaton::MAX_WORD_SIZE) {
+		return similar_words;
+	}
+	const LevenshteinAutomaton automaton(word, max_edits);
+	// Typos are looked for past the first letter only, so the walk stays within that letter's range.
+	for (const TermDictionary::Run* run : {&term_dictionary_.GetMainRun(), &term_dictionary_.GetTail()}) {
+		const auto [first, last] = TermDictionary::PrefixRange(*run, word.substr(0, 1));
+		automaton.ForEachMatch(first, last, [this, &similar_words](string_view similar_word, int distance) {
+			const auto postings = FindWord(similar_word);
+			if (distance > 0 && !postings->second.empty()) {
+				similar_words.emplace_back(postings, distance);
+			}
+		});
+	}
+	return similar_words;
+}
+
+void SearchServer::ExpandQuery(Query& query) const {
+	query.excluded_words.clear();
+	for (const string_view word : query.minus_words) {
+		if (const auto postings = FindWord(word); postings != word_to_document_freqs_.end()) {
+			query.excluded_words.push_back(postings);
+		}
+	}
+	for (const string_view prefix : query.minus_prefixes) {
+		const auto words = ExpandPrefix(prefix);
+		query.excluded_words.insert(query.excluded_words.end(), words.begin(), words.end());
+	}
+	vector<ScoredWord>& scored_words = query.scored_words;
+	scored_words.clear();
+	for (const auto word : FindPlusWords(query, false)) {
+		scored_words.push_back({word, 1.0, TermRole::PLUS});
+	}
+	for (const string_view prefix : query.plus_prefixes) {
+		for (const auto word : ExpandPrefix(prefix)) {
+			scored_words.push_back({word, 1.0, TermRole::PREFIX_EXPANSION});
+		}
+	}
+	for (const string_view word : query.fuzzy_words) {
+		for (const auto& [similar_word, edits] : ExpandFuzzy(word)) {
+			if (query.plus_words.count(similar_word->first) == 0) {
+				scored_words.push_back({similar_word, pow(fuzzy_penalty_, edits), TermRole::FUZZY_EXPANSION});
+			}
+		}
+	}
+	stable_sort(scored_words.begin(), scored_words.end(), [](const ScoredWord& lhs, const ScoredWord& rhs) {
+		return lhs.word->first < rhs.word->first;
+	});
+}
+
+void SearchServer::InsertImpactPosting(string_view word, const Posting& posting, DocumentStatus status) {
+	const auto target = impact_postings_.find({word, status});
+	if (target == impact_postings_.end()) {
+		return;
+	}
+	auto& [main, tail] = target->second;
+	const auto is_before = [this](const Posting& lhs, const Posting& rhs) {
+		return IsImpactBefore(lhs, rhs);
+	};
+	// A document moving back to this status finds the posting it left behind.
+	for (const pmr::vector<Posting>* run : {&main, &tail}) {
+		const auto it = lower_bound(run->begin(), run->end(), posting, is_before);
+		if (it != run->end() && it->ordinal == posting.ordinal) {
+			return;
+		}
+	}
+	tail.insert(upper_bound(tail.begin(), tail.end(), posting, is_before), posting);
+	if (tail.size() * tail.size() > max(main.size(), IMPACT_MIN_MERGED_SIZE)) {
+		const auto middle = static_cast<ptrdiff_t>(main.size());
+		main.insert(main.end(), tail.begin(), tail.end());
+		inplace_merge(main.begin(), main.begin() + middle, main.end(), is_before);
+		tail.clear();
+	}
+}
+
+namespace {
+
+struct ThreadScoreAccumulator {
+	ScoreAccumulator accumulator;
+	bool is_lent = false;
+};
+
+ThreadScoreAccumulator& GetThreadScoreAccumulator() {
+	static thread_local ThreadScoreAccumulator accumulator;
+	return accumulator;
+}
+
+} // namespace
+
+SearchServer::ScoreAccumulatorLease::ScoreAccumulatorLease(size_t document_count) {
+	ThreadScoreAccumulator& thread_accumulator = GetThreadScoreAccumulator();
+	if (thread_accumulator.is_lent) {
+		accumulator_ = &own_accumulator_.emplace();
+	} else {
+		thread_accumulator.is_lent = true;
+		accumulator_ = &thread_accumulator.accumulator;
+	}
+	accumulator_->Reserve(document_count);
+}
+
+SearchServer::ScoreAccumulatorLease::~ScoreAccumulatorLease() {
+	accumulator_->Clear();
+	if (!own_accumulator_) {
+		GetThreadScoreAccumulator().is_lent = false;
+	}
+}
+
+void SearchServer::FilterByPositionalConstraints(const Query& query, const vector<DocumentStatus>& statuses, ScoredDocuments& scored_documents) const {
+	if (!positional_index_) {
+		throw logic_error("Phrase and NEAR queries need EnablePositionalIndex()"s);
+	}
+	// The dense kernel returns documents in first-touch order.
+	sort(scored_documents.begin(), scored_documents.end());
+	const auto filter = [this, &statuses, &scored_documents](const vector<string_view>& words, const auto& matches) {
+		size_t rarest_size = numeric_limits<size_t>::max();
+		for (const string_view word : words) {
+			const auto postings = FindWord(word);
+			rarest_size = min(rarest_size, postings == word_to_document_freqs_.end() ? 0 : postings->second.size());
+		}
+		// Few scored documents: check them directly instead of walking the postings.
+		if (scored_documents.size() <= rarest_size) {
+			scored_documents.erase(remove_if(scored_documents.begin(), scored_documents.end(), [&matches](const auto& scored_document) {
+				return !matches(scored_document.first);
+			}), scored_documents.end());
+			return;
+		}
+		vector<uint32_t> candidates;
+		for (const DocumentStatus status : statuses) {
+			const vector<uint32_t> status_candidates = IntersectPostings(words, status);
+			candidates.insert(candidates.end(), status_candidates.begin(), status_candidates.end());
+		}
+		sort(candidates.begin(), candidates.end());
+		auto candidate = candidates.begin();
+		auto kept = scored_documents.begin();
+		for (const auto& scored_document : scored_documents) {
+			candidate = lower_bound(candidate, candidates.end(), scored_document.first);
+			if (candidate != candidates.end() && *candidate == scored_document.first && matches(scored_document.first)) {
+				*kept++ = scored_document;
+			}
+		}
+		scored_documents.erase(kept, scored_documents.end());
+	};
+	for (const Phrase& phrase : query.phrases) {
+		vector<string_view> words;
+		for (const auto& [word, _] : phrase.words) {
+			words.push_back(word);
+		}
+		filter(words, [this, &phrase](uint32_t ordinal) { return MatchesPhrase(phrase, ordinal); });
+	}
+	for (const Proximity& proximity : query.proximities) {
+		filter({proximity.left, proximity.right}, [this, &proximity](uint32_t ordinal) { return MatchesProximity(proximity, ordinal); });
+	}
+}
+
+vector<uint32_t> SearchServer::IntersectPostings(const vector<string_view>& words, DocumentStatus status) const {
+	vector<const PostingList*> lists;
+	for (const string_view word : words) {
+		const auto postings = FindWord(word);
+		if (postings == word_to_document_freqs_.end()) {
+			return {};
+		}
+		lists.push_back(&postings->second.GetPartition(status));
+	}
+	sort(lists.begin(), lists.end(), [](const PostingList* lhs, const PostingList* rhs) {
+		return lhs->size() < rhs->size();
+	});
+	vector<PostingList::const_iterator> positions;
+	for (const PostingList* list : lists) {
+		positions.push_back(list->begin());
+	}
+	vector<uint32_t> result;
+	for (const Posting& posting : *lists.front()) {
+		bool in_all = true;
+		for (size_t i = 1; i < lists.size() && in_all; ++i) {
+			positions[i] = lists[i]->Seek(positions[i], posting.ordinal);
+			if (positions[i] == lists[i]->end()) {
+				return result;
+			}
+			in_all = positions[i]->ordinal == posting.ordinal;
+		}
+		if (in_all) {
+			result.push_back(posting.ordinal);
+		}
+	}
+	return result;
+}
+
+bool SearchServer::MatchesPhrase(const Phrase& phrase, uint32_t ordinal) const {
+	vector<uint32_t> positions;
+	const auto& [first_word, first_offset] = phrase.words.front();
+	if (!positional_index_->GetPositions(first_word, ordinal, positions)) {
+		return false;
+	}
+	vector<uint32_t> starts;
+	for (const uint32_t position : positions) {
+		if (position >= first_offset) {
+			starts.push_back(position - first_offset);
+		}
+	}
+	for (size_t i = 1; i < phrase.words.size() && !starts.empty(); ++i) {
+		const auto& [word, offset] = phrase.words[i];
+		if (!positional_index_->GetPositions(word, ordinal, positions)) {
+			return false;
+		}
+		starts.erase(remove_if(starts.begin(), starts.end(), [&positions, offset = offset](uint32_t start) {
+			return !binary_search(positions.begin(), positions.end(), start + offset);
+		}), starts.end());
+	}
+	return !starts.empty();
+}
+
+bool SearchServer::MatchesProximity(const Proximity& proximity, uint32_t ordinal) const {
+	vector<uint32_t> left_positions;
+	vector<uint32_t> right_positions;
+	if (!positional_index_->GetPositions(proximity.left, ordinal, left_positions)
+			|| !positional_index_->GetPositions(proximity.right, ordinal, right_positions)) {
+		return false;
+	}
+	size_t left = 0;
+	size_t right = 0;
+	while (left < left_positions.size() && right < right_positions.size()) {
+		const uint32_t distance = left_positions[left] > right_positions[right]
+				? left_positions[left] - right_positions[right] : right_positions[right] - left_positions[left];
+		if (distance <= proximity.max_distance) {
+			return true;
+		}
+		if (left_positions[left] < right_positions[right]) {
+			++left;
+		} else {
+			++right;
+		}
+	}
+	return false;
+}
+
+double SearchServer::ComputeInverseDocumentFreq(size_t document_freq) const {
+	return log(GetDocumentCount() * 1.0 / document_freq);
+}
+
+SearchServer::WordToDocumentFreqs::const_iterator SearchServer::FindWord(string_view word) const {
+	const auto* postings = word_index_.Find(word);
+	return postings ? WordToDocumentFreqs::const_iterator(*postings) : word_to_document_freqs_.end();
+}
+
+vector<SearchServer::WordToDocumentFreqs::const_iterator> SearchServer::ExpandPrefix(string_view prefix) const {
+	const auto [main_first, main_last] = TermDictionary::PrefixRange(term_dictionary_.GetMainRun(), prefix);
+	const auto [tail_first, tail_last] = TermDictionary::PrefixRange(term_dictionary_.GetTail(), prefix);
+	vector<string_view> matches;
+	matches.reserve((main_last - main_first) + (tail_last - tail_first));
+	merge(main_first, main_last, tail_first, tail_last, back_inserter(matches));
+	vector<WordToDocumentFreqs::const_iterator> words;
+	words.reserve(matches.size());
+	for (const string_view word : matches) {
+		words.push_back(FindWord(word));
+	}
+	return words;
 }
@@ -2,27 +2,118 @@
 
 #include "concurrent_map.h"
 #include "document.h"
+#include "document_reordering.h"
+#include "hashed_word_index.h"
+#include "levenshtein_automaton.h"
+#include "memory_accounting.h"
+#include "perfect_hash_set.h"
+#include "positional_index.h"
+#include "posting_list.h"
+#include "query_budget.h"
+#include "query_profiler.h"
 #include "read_input_functions.h"
+#include "score_accumulator.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <deque>
 #include <execution>
+#include <functional>
+#include <future>
+#include <limits>
 #include <list>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <shared_mutex>
 #include <stdexcept>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 
+// What AddDocument does with a document whose set of words equals that of an indexed document.
+enum class DuplicatePolicy {
+	REJECT,       // throw std::invalid_argument
+	KEEP_OLDEST,  // skip the new document
+	REPORT,       // index it anyway
+};
+
+// Predicate of the status overloads of the queries. Queries recognise it by type and read only the status's
+// partition of every posting list instead of testing the documents of all statuses.
+struct DocumentStatusPredicate {
+	DocumentStatus status;
+
+	bool operator()(int document_id, DocumentStatus document_status, int rating) const {
+		return document_status == status;
+	}
+};
+
 class SearchServer {
 public:
+	// Every index container allocates from resource; pass a monotonic or pool resource to keep the index
+	// in arenas. Unsynchronized resources must not be combined with parallel execution policies or
+	// AddDocumentConcurrently.
 	template <typename StringContainer>
-	explicit SearchServer(const StringContainer& stop_words);
-	explicit SearchServer(const std::string& stop_words_text);
-	explicit SearchServer(std::string_view stop_words_text);
+	explicit SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	explicit SearchServer(const std::string& stop_words_text, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	explicit SearchServer(std::string_view stop_words_text, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	// A moved server takes its memory resources along. Assignment would have to move the containers into
+	// the resources of the index it replaces, so it is not supported.
+	SearchServer(SearchServer&&) = default;
+	SearchServer& operator=(SearchServer&&) = delete;
 
 	void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+	// Ingestion from many threads at once. Documents are split and checked in the calling thread, their ids
+	// reserved in lock-striped buckets, and then staged in one of INGEST_STRIPE_COUNT buffers; a buffer that
+	// reaches INGEST_BATCH_SIZE documents is merged into the index. A merge registers the documents and
+	// their new words under an exclusive lock, then adds the postings one term shard at a time under the
+	// shard's lock, so merges from different threads fill different shards at once. Staged documents
+	// become searchable after the merge, so call FlushIngest before querying. Only AddDocumentConcurrently
+	// calls may overlap each other. Duplicates found by EnableDuplicateDetection are never thrown at merge
+	// time: REJECT and KEEP_OLDEST drop them, and FlushIngest returns their ids.
+	static const size_t INGEST_STRIPE_COUNT = 16;
+	static const size_t INGEST_BATCH_SIZE = 256;
+	static const size_t INGEST_TERM_SHARD_COUNT = 16;
+	void AddDocumentConcurrently(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+	// Merges the staged documents. Returns the ids of the documents dropped as duplicates, under REJECT or
+	// KEEP_OLDEST, by the merges since the previous call, in merge order.
+	std::vector<int> FlushIngest();
+
+	// Keeps word positions for "quoted phrases" and "word NEAR/k word" queries. Must be called before
+	// the first AddDocument; without it such queries throw std::logic_error.
+	void EnablePositionalIndex();
+
+	// Keeps a hash index of word-set fingerprints, so AddDocument finds duplicates in O(document length)
+	// instead of a RemoveDuplicates pass. on_duplicate(duplicate_id, original_id) is called for every
+	// duplicate found, before the policy applies. Documents added earlier are indexed on the call.
+	void EnableDuplicateDetection(DuplicatePolicy policy, std::function<void(int, int)> on_duplicate = nullptr);
+
+	// Opt-in typo tolerance: plain plus words of a query also match the dictionary words within max_edits
+	// (at most 2) edits past the first letter, which must be the same, scored with weight penalty^edits.
+	// Words shorter than 6 letters get at most one edit, shorter than 3 none. max_edits = 0 turns it off.
+	// A query word's automaton reads only the term dictionary's range of its first letter, scanning a short
+	// range word by word and walking a long one by prefix, so the cost grows with that range.
+	void SetFuzzyMatching(int max_edits, double penalty = 0.5);
+
+	// Keeps impact-ordered copies of the posting lists with at least min_posting_count documents, one per
+	// status partition. A query scoring a single such word then reads postings in rank order and stops once
+	// the top is settled. Added, removed and re-statused documents are put into or taken out of the copies
+	// in place, so they keep working on a live index; words that grow past the limit need another call.
+	static const size_t IMPACT_ORDER_MIN_POSTINGS = 1024;
+	void BuildImpactOrder(size_t min_posting_count = IMPACT_ORDER_MIN_POSTINGS);
+
+	// Offline pass for static indexes: renumbers the documents internally so that documents sharing words
+	// get close ordinals (recursive graph bisection), and drops the slots of removed documents.
+	// Document ids and search results do not change. Must not run concurrently with queries.
+	void ReorderDocuments();
+
 	template <typename ExecutionPolicy, typename DocumentPredicate>
 	std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 	template <typename ExecutionPolicy>
@@ -35,6 +126,52 @@ public:
 	std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
 	std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+	// Same results as FindTopDocuments for each query, but every posting list is read once per chunk of
+	// BATCH_QUERY_COUNT queries and its contributions are fanned out to all the queries using it.
+	// Queries with +required words, phrases or NEAR run one by one.
+	static constexpr size_t BATCH_QUERY_COUNT = 1024;
+	// Dense score slots shared by the queries of a chunk: a chunk scores the documents in windows of
+	// BATCH_SCORE_SLOTS / chunk size ordinals.
+	static constexpr size_t BATCH_SCORE_SLOTS = size_t{1} << 20;
+	std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+	// Bounded queries: scoring stops once the budget's deadline passes or its token is cancelled and the best
+	// documents seen so far come back flagged as partial. Async calls must not outlive the server.
+	template <typename DocumentPredicate>
+	SearchResult FindTopDocumentsWithin(std::string_view raw_query, const QueryBudget& budget, DocumentPredicate document_predicate) const;
+	SearchResult FindTopDocumentsWithin(std::string_view raw_query, const QueryBudget& budget, DocumentStatus status) const;
+	SearchResult FindTopDocumentsWithin(std::string_view raw_query, const QueryBudget& budget) const;
+
+	// Explain mode: the result of a sequential FindTopDocuments together with the scoring path, the time and
+	// candidate count of every stage, and per-word posting, predicate and minus-word counters. Ordinary
+	// queries pay nothing for it: their kernels are instantiated with the empty NullProfiler.
+	template <typename DocumentPredicate>
+	QueryExplanation ExplainTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+	QueryExplanation ExplainTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+	QueryExplanation ExplainTopDocuments(std::string_view raw_query) const;
+
+	template <typename DocumentPredicate>
+	std::future<SearchResult> FindTopDocumentsAsync(std::string raw_query, QueryBudget budget, DocumentPredicate document_predicate) const;
+	std::future<SearchResult> FindTopDocumentsAsync(std::string raw_query, QueryBudget budget, DocumentStatus status) const;
+	std::future<SearchResult> FindTopDocumentsAsync(std::string raw_query, QueryBudget budget) const;
+
+	// Search-after pagination: returns up to page_size documents ranked strictly after last
+	// (the final document of the previous page), or the first page when last is empty. Only single-word
+	// queries served from impact-ordered copies stop early, reading postings down to the end of the page;
+	// every other query scores all its matches and then drops those up to the cursor, so a deep page costs
+	// a full query.
+	template <typename ExecutionPolicy, typename DocumentPredicate>
+	std::vector<Document> FindTopDocumentsAfter(ExecutionPolicy&& policy, std::string_view raw_query, const std::optional<Document>& last, size_t page_size, DocumentPredicate document_predicate) const;
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocumentsAfter(ExecutionPolicy&& policy, std::string_view raw_query, const std::optional<Document>& last, size_t page_size, DocumentStatus status) const;
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocumentsAfter(ExecutionPolicy&& policy, std::string_view raw_query, const std::optional<Document>& last, size_t page_size) const;
+
+	template <typename DocumentPredicate>
+	std::vector<Document> FindTopDocumentsAfter(std::string_view raw_query, const std::optional<Document>& last, size_t page_size, DocumentPredicate document_predicate) const;
+	std::vector<Document> FindTopDocumentsAfter(std::string_view raw_query, const std::optional<Document>& last, size_t page_size, DocumentStatus status) const;
+	std::vector<Document> FindTopDocumentsAfter(std::string_view raw_query, const std::optional<Document>& last, size_t page_size) const;
+
 	int GetDocumentCount() const;
 
 	auto begin() const {
@@ -45,51 +182,322 @@ public:
 		return document_ids_.end();
 	}
 
-	const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+	const std::pmr::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+
+	// Exact bytes per index structure, read from counters: cheap enough to export as metrics on every scrape.
+	MemoryStats GetMemoryStats() const;
+	// Per-word breakdown; zeros for words outside the dictionary.
+	TermMemory GetTermMemory(std::string_view word) const;
+	// The count words holding the most memory, largest first. Walks the whole dictionary, so it is meant
+	// for occasional capacity reports rather than periodic metrics.
+	std::vector<TermMemory> GetLargestTerms(size_t count) const;
 
 	template <typename ExecutionPolicy>
 	void RemoveDocument(ExecutionPolicy&& policy, int document_id) ;
 	void RemoveDocument(int document_id);
 
+	// Moves the document's postings to the partitions of the new status in place, impact-ordered copies
+	// included, without splitting its text again. Throws std::out_of_range for an unknown id.
+	void SetDocumentStatus(int document_id, DocumentStatus status);
+
 	template <typename ExecutionPolicy>
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const;
 	std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
 
 private:
+	// Documents are addressed by dense ordinals in insertion order; removed documents keep their slot until
+	// CompactDocuments drops the slots.
 	struct DocumentData {
+		int id;
+		int rating;
+		DocumentStatus status;
+		// Its postings are still in the lists until CompactDocuments; every reader skips them.
+		bool is_removed = false;
+	};
+
+	struct IndexResources {
+		explicit IndexResources(std::pmr::memory_resource* upstream)
+			: stop_words(upstream)
+			, word_to_document_freqs(upstream)
+			, word_index(upstream)
+			, document_to_word_freqs(upstream)
+			, documents(upstream)
+			, document_ordinals(upstream)
+			, fingerprints(upstream)
+			, document_ids(upstream)
+			, positions(upstream)
+			, impact_postings(upstream)
+			, term_dictionary(upstream)
+			, words(upstream)
+			, word_arena(&words) {
+		}
+
+		CountingResource stop_words;
+		CountingResource word_to_document_freqs;
+		CountingResource word_index;
+		CountingResource document_to_word_freqs;
+		CountingResource documents;
+		CountingResource document_ordinals;
+		CountingResource fingerprints;
+		CountingResource document_ids;
+		CountingResource positions;
+		CountingResource impact_postings;
+		CountingResource term_dictionary;
+		CountingResource words;
+		// Word bytes are only ever appended: words stay in the dictionary even when their documents are removed.
+		std::pmr::monotonic_buffer_resource word_arena;
+	};
+
+	// Keys point into IndexResources::word_arena.
+	using WordToDocumentFreqs = std::pmr::map<std::string_view, PartitionedPostingList>;
+
+	// Declared first: the containers below allocate from it and must be destroyed before it.
+	std::unique_ptr<IndexResources> resources_;
+	// Not const, so that a moved server takes them along with the resources they allocate from.
+	std::pmr::set<std::pmr::string, std::less<>> stop_words_;
+	PerfectHashSet stop_word_table_;
+	WordToDocumentFreqs word_to_document_freqs_;
+	// Characters stored in IndexResources::word_arena, to tell its slack from its content.
+	size_t stored_word_bytes_ = 0;
+	// Every word of word_to_document_freqs_; query words outside the corpus mostly stop at its Bloom filter.
+	HashedWordIndex<WordToDocumentFreqs::iterator> word_index_;
+	std::pmr::map<int, std::pmr::map<std::string_view, double>> document_to_word_freqs_;
+	std::pmr::vector<DocumentData> documents_;
+	std::pmr::map<int, uint32_t> document_ordinals_;
+	std::pmr::set<int> document_ids_;
+	std::unique_ptr<PositionalIndex> positional_index_;
+	// Every word of word_to_document_freqs_ in byte order, for prefix expansion and the fuzzy walk.
+	TermDictionary term_dictionary_;
+	// Copy of a status partition of a long posting list, sorted by IsImpactBefore. New postings go into a
+	// short sorted tail, merged into the main run once it outgrows the square root of it, so an insert moves
+	// O(sqrt(n)) postings on average. Postings of documents removed or moved to another status stay until
+	// the next compaction and are skipped by the scan; a document moving back finds its posting again.
+	struct ImpactPostings {
+		using allocator_type = std::pmr::polymorphic_allocator<Posting>;
+
+		explicit ImpactPostings(const allocator_type& allocator) : main(allocator), tail(allocator) {
+		}
+
+		ImpactPostings(const ImpactPostings& other, const allocator_type& allocator) : main(other.main, allocator), tail(other.tail, allocator) {
+		}
+
+		ImpactPostings(ImpactPostings&& other, const allocator_type& allocator) : main(std::move(other.main), allocator), tail(std::move(other.tail), allocator) {
+		}
+
+		std::pmr::vector<Posting> main;
+		std::pmr::vector<Posting> tail;
+	};
+
+	// Lets the tail of a small copy reach 8 postings before a merge.
+	static constexpr size_t IMPACT_MIN_MERGED_SIZE = 64;
+	std::pmr::map<std::pair<std::string_view, DocumentStatus>, ImpactPostings> impact_postings_;
+	std::optional<DuplicatePolicy> duplicate_policy_;
+	std::function<void(int, int)> on_duplicate_;
+	// Word-set fingerprint -> document id; fingerprints may collide, so candidates are compared word by word.
+	std::pmr::unordered_multimap<uint64_t, int> fingerprint_documents_;
+	int fuzzy_max_edits_ = 0;
+	double fuzzy_penalty_ = 0.5;
+
+	// Distinct words of a document in byte order with their term frequencies.
+	using TermFreqs = std::vector<std::pair<std::string_view, double>>;
+
+	// A document parsed by AddDocumentConcurrently; words point into text.
+	struct StagedDocument {
+		int id;
+		DocumentStatus status;
 		int rating;
+		std::unique_ptr<std::string> text;
+		TermFreqs term_freqs;
+	};
+
+	struct IngestStripe {
+		std::mutex mutex;
+		std::vector<StagedDocument> documents;
+	};
+
+	// A posting of a merged document, added to its word after the documents of the batch are registered.
+	struct StagedPosting {
+		WordToDocumentFreqs::iterator word;
+		uint32_t ordinal;
 		DocumentStatus status;
+		double term_freq;
 	};
 
-	const std::set<std::string> stop_words_;
-	std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-	std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-	std::map<int, DocumentData> documents_;
-	std::set<int> document_ids_;
+	// An id is reserved from AddDocumentConcurrently until its merge has put it into document_ordinals_,
+	// so a concurrent duplicate always finds it in one of the two.
+	struct IngestState {
+		IngestState() : reserved_ids(INGEST_STRIPE_COUNT) {
+		}
+
+		// Held exclusively to register documents, shared while postings are added to the term shards.
+		std::shared_mutex index_mutex;
+		ConcurrentMap<int, bool> reserved_ids;
+		std::array<IngestStripe, INGEST_STRIPE_COUNT> stripes;
+		// Guards the posting lists and impact-ordered copies of the words hashed to it.
+		std::array<std::mutex, INGEST_TERM_SHARD_COUNT> term_shards;
+		// Guarded by index_mutex.
+		std::vector<int> dropped_ids;
+	};
+
+	std::unique_ptr<IngestState> ingest_;
 
 	struct QueryWord {
 		std::string_view data;
 		bool is_minus;
 		bool is_stop;
+		bool is_prefix;
+		bool is_required;
+	};
+
+	struct Phrase {
+		// Words with their offsets from the phrase start; stop words are dropped but keep their slot.
+		std::vector<std::pair<std::string, uint32_t>> words;
+	};
+
+	struct Proximity {
+		std::string left;
+		std::string right;
+		uint32_t max_distance;
+	};
+
+	// Dictionary word with the factor applied to its inverse document frequency.
+	struct ScoredWord {
+		WordToDocumentFreqs::const_iterator word;
+		double weight;
+		TermRole role;
 	};
 
+	// Phrase, proximity and required (+word) words are also plus words. Required words switch the query
+	// to conjunctive mode; phrase and proximity constraints only filter the scored documents.
 	struct Query {
 		std::set<std::string, std::less<>> plus_words;
+		std::set<std::string, std::less<>> required_words;
 		std::set<std::string, std::less<>> minus_words;
+		std::set<std::string, std::less<>> plus_prefixes;
+		std::set<std::string, std::less<>> minus_prefixes;
+		// Plain plus words to expand with similar dictionary words; empty unless fuzzy matching is on.
+		std::set<std::string, std::less<>> fuzzy_words;
+		std::vector<Phrase> phrases;
+		std::vector<Proximity> proximities;
+		// Plus words, prefix and fuzzy expansions in word order, a word matched twice listed twice; set
+		// once by ExpandQuery for all the kernels. This order fixes the floating-point summation of relevance,
+		// so every path and batched queries score a document identically.
+		std::vector<ScoredWord> scored_words;
+		// Minus words and minus prefix expansions found in the dictionary, also set by ExpandQuery.
+		std::vector<WordToDocumentFreqs::const_iterator> excluded_words;
 	};
 
+	// ParseQueryWords followed by ExpandQuery.
 	Query ParseQuery(std::string_view text) const;
+	Query ParseQueryWords(std::string_view text) const;
+	void ExpandQuery(Query& query) const;
 	QueryWord ParseQueryWord(std::string_view text) const;
+	size_t ParsePhrase(const std::vector<std::string_view>& words, size_t first, Query& query) const;
+	static std::optional<uint32_t> ParseProximityOperator(std::string_view word);
 
 	bool IsStopWord(std::string_view word) const;
 	static bool IsValidWord(std::string_view word);
 	std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
 
+	std::string_view StoreWord(std::string_view word);
+	static TermFreqs ComputeTermFreqs(std::vector<std::string_view> words);
+	// Indexes a document with a new id and valid words. Throws std::invalid_argument for a duplicate under REJECT
+	// and returns false for one skipped under KEEP_OLDEST. With staged_postings the postings and impact-ordered
+	// copies of its words are left out and appended there.
+	bool IndexDocument(int document_id, std::string_view document, const TermFreqs& term_freqs, DocumentStatus status, int rating,
+			std::vector<StagedPosting>* staged_postings = nullptr);
+	void MergeStagedDocuments(std::vector<StagedDocument>& documents);
+	static uint64_t ComputeFingerprint(const std::vector<std::string_view>& sorted_words);
+	std::vector<std::string_view> GetDocumentWords(int document_id) const;
+	std::optional<int> FindDuplicate(uint64_t fingerprint, const std::vector<std::string_view>& sorted_words) const;
+	void EraseFingerprint(int document_id);
+	static std::pmr::set<std::pmr::string, std::less<>> MakeStopWords(const std::set<std::string>& stop_words, std::pmr::memory_resource* resource);
 	static int ComputeAverageRating(const std::vector<int>& ratings);
-	double ComputeWordInverseDocumentFreq(const std::string& word) const;
+	double ComputeInverseDocumentFreq(size_t document_freq) const;
+	// Hashed lookup; word_to_document_freqs_.end() for words outside the dictionary.
+	WordToDocumentFreqs::const_iterator FindWord(std::string_view word) const;
+	std::vector<WordToDocumentFreqs::const_iterator> ExpandPrefix(std::string_view prefix) const;
+	// Dictionary words within the fuzzy edit distance of word that start with its first letter, other than
+	// word itself, with their distance. Words longer than LevenshteinAutomaton::MAX_WORD_SIZE are not expanded.
+	std::vector<std::pair<WordToDocumentFreqs::const_iterator, int>> ExpandFuzzy(std::string_view word) const;
 
-	template <typename ExecutionPolicy, typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(ExecutionPolicy policy, const Query& query, DocumentPredicate document_predicate) const ;
+	template <typename ExecutionPolicy, typename DocumentPredicate, typename Budget = UnlimitedBudget, typename Profiler = NullProfiler>
+	std::vector<Document> FindAllDocuments(ExecutionPolicy policy, const Query& query, DocumentPredicate document_predicate, const Budget& budget = Budget(), const Profiler& profiler = Profiler()) const ;
+
+	// Scored documents are (ordinal, relevance) pairs.
+	using ScoredDocuments = std::vector<std::pair<uint32_t, double>>;
+
+	std::vector<WordToDocumentFreqs::const_iterator> FindPlusWords(const Query& query, bool rarest_first) const;
+
+	// Term-at-a-time over a dense per-thread accumulator; used for sequential disjunctive queries.
+	template <typename DocumentPredicate, typename Budget, typename Profiler>
+	ScoredDocuments ComputeDenseRelevance(const Query& query, DocumentPredicate document_predicate, const Budget& budget, const Profiler& profiler) const;
+
+	template <typename ExecutionPolicy, typename DocumentPredicate, typename Budget>
+	ScoredDocuments ComputeConcurrentRelevance(ExecutionPolicy policy, const Query& query, DocumentPredicate document_predicate, const Budget& budget) const;
+
+	template <typename DocumentPredicate, typename Budget, typename Profiler>
+	ScoredDocuments ComputeConjunctiveRelevance(const Query& query, DocumentPredicate document_predicate, const Budget& budget, const Profiler& profiler) const;
+
+	// Statuses whose partitions can hold documents accepted by document_predicate.
+	template <typename DocumentPredicate>
+	static std::vector<DocumentStatus> GetSearchedStatuses(const DocumentPredicate& document_predicate);
+
+	// Gives the documents at old_ordinals the ordinals 0, 1, ... in that order and drops the other slots.
+	void RenumberDocuments(const std::vector<uint32_t>& old_ordinals);
+	// Drops the slots of removed documents once they outnumber the live ones, so that removals do not
+	// grow documents_ and the score accumulators without bound. Compaction reads every posting, and
+	// waiting until half the slots are removed spreads that cost over as many removals.
+	static constexpr size_t COMPACTION_MIN_REMOVED = 1024;
+	void CompactDocuments();
+	// Whether the posting of ordinal in the partition of status is marked removed: the document was removed
+	// or moved to another status. Every reader skips such postings.
+	bool IsRemovedPosting(uint32_t ordinal, DocumentStatus status) const;
+	// Term frequency descending, then rating descending, then id.
+	bool IsImpactBefore(const Posting& lhs, const Posting& rhs) const;
+	// Keeps an existing copy of the word's status partition current; words without a copy are left alone.
+	// Needs documents_ to hold the document already. Leaving a copy needs no call: the scan skips the posting.
+	void InsertImpactPosting(std::string_view word, const Posting& posting, DocumentStatus status);
+	// Top documents ranked after last from impact-ordered copies; nullopt unless the query scores exactly one
+	// word with a copy of every searched partition that is not empty.
+	template <typename DocumentPredicate, typename Profiler = NullProfiler>
+	std::optional<std::vector<Document>> FindTopDocumentsByImpact(const Query& query, DocumentPredicate document_predicate, size_t count,
+			const std::optional<Document>& last = std::nullopt, const Profiler& profiler = Profiler()) const;
+
+	// Lends the calling thread's ScoreAccumulator, shared by all servers, to one query at a time, and clears
+	// it on return even if the predicate throws. A query run from a predicate of another query on the same
+	// thread scores into an accumulator of its own.
+	class ScoreAccumulatorLease {
+	public:
+		explicit ScoreAccumulatorLease(size_t document_count);
+		ScoreAccumulatorLease(const ScoreAccumulatorLease&) = delete;
+		ScoreAccumulatorLease& operator=(const ScoreAccumulatorLease&) = delete;
+		~ScoreAccumulatorLease();
+
+		ScoreAccumulator& Get() {
+			return *accumulator_;
+		}
+
+	private:
+		ScoreAccumulator* accumulator_;
+		std::optional<ScoreAccumulator> own_accumulator_;
+	};
+	// Expects the ordinals of each status in scored_documents to increase.
+	template <typename Profiler = NullProfiler>
+	void ExcludeMinusWords(const Query& query, ScoredDocuments& scored_documents, const Profiler& profiler = Profiler()) const;
+
+	static bool HasPositionalConstraints(const Query& query);
+	void FilterByPositionalConstraints(const Query& query, const std::vector<DocumentStatus>& statuses, ScoredDocuments& scored_documents) const;
+	// Ordinals of the documents with status that contain all the words, increasing.
+	std::vector<uint32_t> IntersectPostings(const std::vector<std::string_view>& words, DocumentStatus status) const;
+	bool MatchesPhrase(const Phrase& phrase, uint32_t ordinal) const;
+	bool MatchesProximity(const Proximity& proximity, uint32_t ordinal) const;
+
+	// Result order: relevance, then rating, then id, so that every document has a stable place for cursors.
+	// Relevances closer than RELEVANCE_EPSILON count as equal.
+	static constexpr double RELEVANCE_EPSILON = 1e-6;
+	static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+	static void SelectTopDocuments(std::vector<Document>& documents, size_t count);
 
 };
 
@@ -100,18 +508,38 @@ template <typename ExecutionPolicy>
 		if (!document_ids_.count(document_id)) {
 			throw std::out_of_range("invalid id");
 		}
+		const uint32_t ordinal = document_ordinals_.at(document_id);
+		const DocumentStatus status = documents_[ordinal].status;
+		if (duplicate_policy_) {
+			EraseFingerprint(document_id);
+		}
 		document_ids_.erase(document_id);
-		documents_.erase(document_id);
+		document_ordinals_.erase(document_id);
+		// Postings, impact-ordered copies and positions keep the document until CompactDocuments drops its slot.
+		documents_[ordinal].is_removed = true;
 		std::for_each(policy, std::make_move_iterator(document_to_word_freqs_.at(document_id).begin()), std::make_move_iterator(document_to_word_freqs_.at(document_id).end()),
-				[this, document_id](const auto& pair) {
-				std::string collected_word{pair.first.begin(), pair.first.end()};
-				return word_to_document_freqs_.at(collected_word).erase(document_id);
+				[this, status](const auto& pair) {
+				word_to_document_freqs_.find(pair.first)->second.MarkRemoved(status);
 		});
 		document_to_word_freqs_.erase(document_id);
+		CompactDocuments();
 	}
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words) : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
+SearchServer::SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource)
+	: resources_(std::make_unique<IndexResources>(resource))
+	, stop_words_(MakeStopWords(MakeUniqueNonEmptyStrings(stop_words), &resources_->stop_words))
+	, stop_word_table_(stop_words_, &resources_->stop_words)
+	, word_to_document_freqs_(&resources_->word_to_document_freqs)
+	, word_index_(&resources_->word_index)
+	, document_to_word_freqs_(&resources_->document_to_word_freqs)
+	, documents_(&resources_->documents)
+	, document_ordinals_(&resources_->document_ordinals)
+	, document_ids_(&resources_->document_ids)
+	, term_dictionary_(&resources_->term_dictionary)
+	, impact_postings_(&resources_->impact_postings)
+	, fingerprint_documents_(&resources_->fingerprints)
+	, ingest_(std::make_unique<IngestState>()) {
 	if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
 		using namespace std;
 		throw invalid_argument("Some of stop words are invalid"s);
@@ -121,17 +549,11 @@ SearchServer::SearchServer(const StringContainer& stop_words) : stop_words_(Make
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
 	const auto query = ParseQuery(raw_query);
-	auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-	sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-		if (std::abs(lhs.relevance - rhs.relevance) < 1e-6) {
-			return lhs.rating > rhs.rating;
-		} else {
-			return lhs.relevance > rhs.relevance;
-		}
-	});
-	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+	if (auto top_documents = FindTopDocumentsByImpact(query, document_predicate, MAX_RESULT_DOCUMENT_COUNT)) {
+		return std::move(*top_documents);
 	}
+	auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+	SelectTopDocuments(matched_documents, MAX_RESULT_DOCUMENT_COUNT);
 	return matched_documents;
 }
 
@@ -142,9 +564,7 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
-	return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-		return document_status == status;
-	});
+	return FindTopDocuments(policy, raw_query, DocumentStatusPredicate{status});
 }
 
 template <typename ExecutionPolicy>
@@ -153,35 +573,457 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, s
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, const Query& query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocumentsAfter(ExecutionPolicy&& policy, std::string_view raw_query, const std::optional<Document>& last, size_t page_size, DocumentPredicate document_predicate) const {
+	const auto query = ParseQuery(raw_query);
+	if (auto top_documents = FindTopDocumentsByImpact(query, document_predicate, page_size, last)) {
+		return std::move(*top_documents);
+	}
+	auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+	if (last.has_value()) {
+		matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(), [&last](const Document& document) {
+			return !IsRankedBefore(*last, document);
+		}), matched_documents.end());
+	}
+	SelectTopDocuments(matched_documents, page_size);
+	return matched_documents;
+}
+
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocumentsWithin(std::string_view raw_query, const QueryBudget& budget, DocumentPredicate document_predicate) const {
+	const auto query = ParseQuery(raw_query);
+	SearchResult result{FindAllDocuments(std::execution::seq, query, document_predicate, budget), budget.WasExhausted()};
+	SelectTopDocuments(result.documents, MAX_RESULT_DOCUMENT_COUNT);
+	return result;
+}
+
+template <typename DocumentPredicate>
+QueryExplanation SearchServer::ExplainTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
 	using namespace std;
-	ConcurrentMap<int, double> document_to_relevance_protect(4);
-	for (const string& word : query.plus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
+	QueryExplanation explanation;
+	const QueryProfiler profiler(explanation);
+	auto query = ParseQueryWords(raw_query);
+	profiler.EndStage("parse"sv, 0);
+	ExpandQuery(query);
+	profiler.EndStage("expand"sv, 0);
+	if (auto top_documents = FindTopDocumentsByImpact(query, document_predicate, MAX_RESULT_DOCUMENT_COUNT, nullopt, profiler)) {
+		explanation.documents = move(*top_documents);
+		return explanation;
+	}
+	explanation.documents = FindAllDocuments(execution::seq, query, document_predicate, UnlimitedBudget(), profiler);
+	SelectTopDocuments(explanation.documents, MAX_RESULT_DOCUMENT_COUNT);
+	profiler.EndStage("select top"sv, explanation.documents.size());
+	return explanation;
+}
+
+template <typename DocumentPredicate>
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(std::string raw_query, QueryBudget budget, DocumentPredicate document_predicate) const {
+	return std::async(std::launch::async, [this, raw_query = std::move(raw_query), budget = std::move(budget), document_predicate]() {
+		return FindTopDocumentsWithin(raw_query, budget, document_predicate);
+	});
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(std::string_view raw_query, const std::optional<Document>& last, size_t page_size, DocumentPredicate document_predicate) const {
+	return FindTopDocumentsAfter(std::execution::seq, raw_query, last, page_size, document_predicate);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(ExecutionPolicy&& policy, std::string_view raw_query, const std::optional<Document>& last, size_t page_size, DocumentStatus status) const {
+	return FindTopDocumentsAfter(policy, raw_query, last, page_size, DocumentStatusPredicate{status});
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(ExecutionPolicy&& policy, std::string_view raw_query, const std::optional<Document>& last, size_t page_size) const {
+	return FindTopDocumentsAfter(policy, raw_query, last, page_size, DocumentStatus::ACTUAL);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Budget, typename Profiler>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy policy, const Query& query, DocumentPredicate document_predicate, const Budget& budget, const Profiler& profiler) const {
+	using namespace std;
+	ScoredDocuments scored_documents;
+	if (!query.required_words.empty()) {
+		profiler.SetPath("conjunctive"sv);
+		scored_documents = ComputeConjunctiveRelevance(query, document_predicate, budget, profiler);
+		ExcludeMinusWords(query, scored_documents, profiler);
+		profiler.EndStage("minus words"sv, scored_documents.size());
+	} else if constexpr (is_same_v<decay_t<ExecutionPolicy>, execution::sequenced_policy>) {
+		profiler.SetPath("dense"sv);
+		scored_documents = ComputeDenseRelevance(query, document_predicate, budget, profiler);
+	} else {
+		scored_documents = ComputeConcurrentRelevance(policy, query, document_predicate, budget);
+		ExcludeMinusWords(query, scored_documents);
+	}
+	if (HasPositionalConstraints(query)) {
+		FilterByPositionalConstraints(query, GetSearchedStatuses(document_predicate), scored_documents);
+		profiler.EndStage("positional filter"sv, scored_documents.size());
+	}
+	vector<Document> matched_documents;
+	matched_documents.reserve(scored_documents.size());
+	for (const auto& [ordinal, relevance] : scored_documents) {
+		const DocumentData& document_data = documents_[ordinal];
+		matched_documents.push_back({document_data.id, relevance, document_data.rating});
+	}
+	return matched_documents;
+}
+
+template <typename DocumentPredicate, typename Budget, typename Profiler>
+SearchServer::ScoredDocuments SearchServer::ComputeDenseRelevance(const Query& query, DocumentPredicate document_predicate, const Budget& budget, const Profiler& profiler) const {
+	using namespace std;
+	using State = ScoreAccumulator::State;
+	ScoreAccumulatorLease lease(documents_.size());
+	ScoreAccumulator& accumulator = lease.Get();
+
+	const auto add_postings = [this, &accumulator, &document_predicate, &budget, &profiler](const PostingList& postings, DocumentStatus status, double inverse_document_freq) {
+		for (auto block = postings.begin(); block != postings.end() && !budget.IsExhausted();) {
+			const auto block_end = block + static_cast<ptrdiff_t>(min<size_t>(Budget::POSTING_BLOCK_SIZE, postings.end() - block));
+			profiler.CountPostings(block_end - block);
+			for (; block != block_end; ++block) {
+				State state = accumulator.GetState(block->ordinal);
+				if (state == State::UNSEEN) {
+					const DocumentData& document_data = documents_[block->ordinal];
+					if (document_data.is_removed) {
+						state = State::REJECTED;
+					} else {
+						state = document_predicate(document_data.id, document_data.status, document_data.rating) ? State::ACCEPTED : State::REJECTED;
+						profiler.CountPredicate(state == State::ACCEPTED);
+					}
+					accumulator.SetState(block->ordinal, state);
+				}
+				if (state == State::ACCEPTED) {
+					// A status move leaves a posting in the old partition. Only a search of several statuses
+					// reaches it for an accepted document, which is scored from its current partition.
+					if constexpr (!is_same_v<DocumentPredicate, DocumentStatusPredicate>) {
+						if (documents_[block->ordinal].status != status) {
+							continue;
+						}
+					}
+					accumulator.Add(block->ordinal, block->term_freq * inverse_document_freq);
+				}
+			}
+		}
+	};
+	const auto statuses = GetSearchedStatuses(document_predicate);
+	const vector<ScoredWord>* scored_words = &query.scored_words;
+	vector<ScoredWord> rarest_first;
+	if constexpr (!is_same_v<Budget, UnlimitedBudget>) {
+		// Rare words carry the most relevance: score them first so that a cut-off query keeps the best part.
+		rarest_first = query.scored_words;
+		stable_sort(rarest_first.begin(), rarest_first.end(), [](const ScoredWord& lhs, const ScoredWord& rhs) {
+			return lhs.word->second.size() < rhs.word->second.size();
+		});
+		scored_words = &rarest_first;
+	}
+	for (const ScoredWord& scored_word : *scored_words) {
+		const PartitionedPostingList& postings = scored_word.word->second;
+		const double inverse_document_freq = ComputeInverseDocumentFreq(postings.size()) * scored_word.weight;
+		profiler.StartTerm(scored_word.word->first, scored_word.role, inverse_document_freq, postings.size());
+		for (const DocumentStatus status : statuses) {
+			add_postings(postings.GetPartition(status), status, inverse_document_freq);
+		}
+		profiler.EndTerm();
+	}
+	if constexpr (Profiler::IS_ENABLED) {
+		profiler.EndStage("score"sv, count_if(accumulator.GetTouched().begin(), accumulator.GetTouched().end(), [&accumulator](uint32_t ordinal) {
+			return accumulator.GetState(ordinal) == State::ACCEPTED;
+		}));
+	}
+	// Documents of the other statuses were never accepted.
+	const auto reject_postings = [&accumulator, &profiler, &statuses](string_view word, const PartitionedPostingList& postings) {
+		profiler.StartTerm(word, TermRole::MINUS, 0.0, postings.size());
+		for (const DocumentStatus status : statuses) {
+			profiler.CountPostings(postings.GetPartition(status).size());
+			for (const Posting& posting : postings.GetPartition(status)) {
+				if constexpr (Profiler::IS_ENABLED) {
+					profiler.CountExcluded(accumulator.GetState(posting.ordinal) == State::ACCEPTED ? 1 : 0);
+				}
+				accumulator.SetState(posting.ordinal, State::REJECTED);
+			}
+		}
+		profiler.EndTerm();
+	};
+	for (const auto word : query.excluded_words) {
+		reject_postings(word->first, word->second);
+	}
+	ScoredDocuments scored_documents;
+	for (const uint32_t ordinal : accumulator.GetTouched()) {
+		if (accumulator.GetState(ordinal) == State::ACCEPTED) {
+			scored_documents.emplace_back(ordinal, accumulator.GetScore(ordinal));
+		}
+	}
+	profiler.EndStage("minus words"sv, scored_documents.size());
+	return scored_documents;
+}
+
+template <typename DocumentPredicate>
+std::vector<DocumentStatus> SearchServer::GetSearchedStatuses(const DocumentPredicate& document_predicate) {
+	if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusPredicate>) {
+		return {document_predicate.status};
+	} else {
+		std::vector<DocumentStatus> statuses;
+		for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+			statuses.push_back(static_cast<DocumentStatus>(status));
+		}
+		return statuses;
+	}
+}
+
+template <typename DocumentPredicate, typename Profiler>
+std::optional<std::vector<Document>> SearchServer::FindTopDocumentsByImpact(const Query& query, DocumentPredicate document_predicate, size_t count,
+		const std::optional<Document>& last, const Profiler& profiler) const {
+	using namespace std;
+	if (impact_postings_.empty() || !query.required_words.empty() || HasPositionalConstraints(query)) {
+		return nullopt;
+	}
+	const vector<ScoredWord>& scored_words = query.scored_words;
+	if (scored_words.size() != 1) {
+		return nullopt;
+	}
+	const string_view scored_word = scored_words.front().word->first;
+	const PartitionedPostingList& postings = scored_words.front().word->second;
+	// Read positions in the runs of the impact-ordered copies of the searched partitions.
+	struct Cursor {
+		pmr::vector<Posting>::const_iterator position;
+		pmr::vector<Posting>::const_iterator end;
+		DocumentStatus status;
+	};
+	vector<Cursor> cursors;
+	size_t impact_count = 0;
+	for (const DocumentStatus status : GetSearchedStatuses(document_predicate)) {
+		if (postings.GetPartition(status).empty()) {
 			continue;
 		}
-		const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-		for_each(policy, word_to_document_freqs_.at(word).begin(), word_to_document_freqs_.at(word).end(), [this, document_predicate,  &document_to_relevance_protect, &inverse_document_freq](const auto& element){
-			const auto& document_data = documents_.at(element.first);
-			if (document_predicate(element.first, document_data.status, document_data.rating)) {
-				document_to_relevance_protect[element.first].ref_to_value += element.second * inverse_document_freq;
+		const auto impact_postings = impact_postings_.find({scored_word, status});
+		if (impact_postings == impact_postings_.end()) {
+			return nullopt;
+		}
+		for (const pmr::vector<Posting>* run : {&impact_postings->second.main, &impact_postings->second.tail}) {
+			cursors.push_back({run->begin(), run->end(), status});
+			impact_count += run->size();
+		}
+	}
+	const auto& excluded_words = query.excluded_words;
+	// Per minus word: documents looked up in its postings and documents it excluded. The lookups are
+	// interleaved with the scan, so their time is part of the scanned word's.
+	vector<pair<size_t, size_t>> minus_counts(Profiler::IS_ENABLED ? excluded_words.size() : 0);
+	const double inverse_document_freq = ComputeInverseDocumentFreq(postings.size()) * scored_words.front().weight;
+	if (count == 0) {
+		return vector<Document>();
+	}
+	profiler.SetPath("impact"sv);
+	profiler.StartTerm(scored_word, scored_words.front().role, inverse_document_freq, impact_count);
+	vector<Document> top_documents;
+	optional<double> threshold;
+	while (true) {
+		// Merges the copies: the next posting is the first in impact order among the cursors.
+		auto next = cursors.end();
+		for (auto cursor = cursors.begin(); cursor != cursors.end(); ++cursor) {
+			if (cursor->position != cursor->end && (next == cursors.end() || IsImpactBefore(*cursor->position, *next->position))) {
+				next = cursor;
 			}
+		}
+		if (next == cursors.end()) {
+			break;
+		}
+		const Posting& posting = *next->position++;
+		profiler.CountPostings(1);
+		const DocumentData& document_data = documents_[posting.ordinal];
+		if (IsRemovedPosting(posting.ordinal, next->status)) {
+			continue;
+		}
+		const Document document{document_data.id, posting.term_freq * inverse_document_freq, document_data.rating};
+		// Relevance only falls from here on: once it drops clearly below the count-th accepted document,
+		// no further document can rank before any of the accepted ones.
+		if (threshold.has_value() && document.relevance < *threshold - RELEVANCE_EPSILON) {
+			break;
+		}
+		// Previous pages: skipped without the predicate, so a page costs the postings above its end.
+		if (last.has_value() && !IsRankedBefore(*last, document)) {
+			continue;
+		}
+		// Within the epsilon band, skip documents already outranked count times without calling the predicate.
+		if (threshold.has_value() && static_cast<size_t>(count_if(top_documents.begin(), top_documents.end(), [&document](const Document& accepted) {
+			return IsRankedBefore(accepted, document);
+		})) >= count) {
+			continue;
+		}
+		const bool is_accepted = document_predicate(document_data.id, document_data.status, document_data.rating);
+		profiler.CountPredicate(is_accepted);
+		if (!is_accepted) {
+			continue;
+		}
+		const auto excluding = find_if(excluded_words.begin(), excluded_words.end(), [&posting, &document_data](const auto word) {
+			return word->second.Contains(posting.ordinal, document_data.status);
 		});
+		if constexpr (Profiler::IS_ENABLED) {
+			for (auto word = excluded_words.begin(); word != excluded_words.end() && word <= excluding; ++word) {
+				++minus_counts[word - excluded_words.begin()].first;
+			}
+			if (excluding != excluded_words.end()) {
+				++minus_counts[excluding - excluded_words.begin()].second;
+			}
+		}
+		if (excluding != excluded_words.end()) {
+			continue;
+		}
+		top_documents.push_back(document);
+		if (top_documents.size() == count && !threshold.has_value()) {
+			threshold = document.relevance;
+		} else if (top_documents.size() == 2 * count) {
+			SelectTopDocuments(top_documents, count);
+		}
+	}
+	SelectTopDocuments(top_documents, count);
+	profiler.EndTerm();
+	for (size_t i = 0; i < minus_counts.size(); ++i) {
+		profiler.StartTerm(excluded_words[i]->first, TermRole::MINUS, 0.0, excluded_words[i]->second.size());
+		profiler.CountPostings(minus_counts[i].first);
+		profiler.CountExcluded(minus_counts[i].second);
+		profiler.EndTerm();
 	}
-	map<int, double> document_to_relevance = move(document_to_relevance_protect.BuildOrdinaryMap());
-	for (const string& word : query.minus_words) {
-		if (word_to_document_freqs_.count(word) == 0) {
+	profiler.EndStage("impact scan"sv, top_documents.size());
+	return top_documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Budget>
+SearchServer::ScoredDocuments SearchServer::ComputeConcurrentRelevance(ExecutionPolicy policy, const Query& query, DocumentPredicate document_predicate, const Budget& budget) const {
+	using namespace std;
+	const auto statuses = GetSearchedStatuses(document_predicate);
+	ConcurrentMap<uint32_t, double> document_to_relevance_protect(4);
+	for (const auto postings : FindPlusWords(query, !is_same_v<Budget, UnlimitedBudget>)) {
+		const double inverse_document_freq = ComputeInverseDocumentFreq(postings->second.size());
+		for (const DocumentStatus status : statuses) {
+			const PostingList& partition = postings->second.GetPartition(status);
+			for (auto block = partition.begin(); block != partition.end() && !budget.IsExhausted();) {
+				const auto block_end = block + static_cast<ptrdiff_t>(min<size_t>(Budget::POSTING_BLOCK_SIZE, partition.end() - block));
+				for_each(policy, block, block_end, [this, document_predicate,  &document_to_relevance_protect, &inverse_document_freq, status](const Posting& posting){
+					const DocumentData& document_data = documents_[posting.ordinal];
+					if (!IsRemovedPosting(posting.ordinal, status) && document_predicate(document_data.id, document_data.status, document_data.rating)) {
+						document_to_relevance_protect[posting.ordinal].ref_to_value += posting.term_freq * inverse_document_freq;
+					}
+				});
+				block = block_end;
+			}
+		}
+	}
+	// A document is in one partition of every list, so each status is merged on its own.
+	const auto add_union = [this, &document_predicate, &document_to_relevance_protect, &budget, &statuses](const vector<pair<const PartitionedPostingList*, double>>& weighted_lists) {
+		for (const DocumentStatus status : statuses) {
+			vector<pair<const PostingList*, double>> partitions;
+			for (const auto& [list, weight] : weighted_lists) {
+				partitions.emplace_back(&list->GetPartition(status), weight);
+			}
+			PostingListUnion postings(partitions);
+			uint32_t ordinal = 0;
+			double relevance = 0.0;
+			for (size_t count = 0; !(count % Budget::POSTING_BLOCK_SIZE == 0 && budget.IsExhausted()) && postings.Next(ordinal, relevance); ++count) {
+				const DocumentData& document_data = documents_[ordinal];
+				if (!IsRemovedPosting(ordinal, status) && document_predicate(document_data.id, document_data.status, document_data.rating)) {
+					document_to_relevance_protect[ordinal].ref_to_value += relevance;
+				}
+			}
+		}
+	};
+	for (const string_view prefix : query.plus_prefixes) {
+		vector<pair<const PartitionedPostingList*, double>> weighted_lists;
+		for (const auto word : ExpandPrefix(prefix)) {
+			weighted_lists.emplace_back(&word->second, ComputeInverseDocumentFreq(word->second.size()));
+		}
+		add_union(weighted_lists);
+	}
+	vector<pair<const PartitionedPostingList*, double>> fuzzy_lists;
+	for (const ScoredWord& scored_word : query.scored_words) {
+		if (scored_word.role != TermRole::FUZZY_EXPANSION) {
 			continue;
 		}
-		for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-			document_to_relevance.erase(document_id);
+		fuzzy_lists.emplace_back(&scored_word.word->second, ComputeInverseDocumentFreq(scored_word.word->second.size()) * scored_word.weight);
+	}
+	add_union(fuzzy_lists);
+	const auto document_to_relevance = document_to_relevance_protect.BuildOrdinaryMap();
+	return ScoredDocuments(document_to_relevance.begin(), document_to_relevance.end());
+}
+
+template <typename DocumentPredicate, typename Budget, typename Profiler>
+SearchServer::ScoredDocuments SearchServer::ComputeConjunctiveRelevance(const Query& query, DocumentPredicate document_predicate, const Budget& budget, const Profiler& profiler) const {
+	using namespace std;
+	const auto statuses = GetSearchedStatuses(document_predicate);
+	const vector<string_view> required_words(query.required_words.begin(), query.required_words.end());
+	vector<vector<uint32_t>> status_candidates;
+	size_t intersected_count = 0;
+	for (const DocumentStatus status : statuses) {
+		status_candidates.push_back(IntersectPostings(required_words, status));
+		intersected_count += status_candidates.back().size();
+	}
+	profiler.EndStage("intersect"sv, intersected_count);
+	// Candidates of each status in increasing ordinal order, one range per status.
+	vector<uint32_t> candidates;
+	vector<pair<DocumentStatus, size_t>> candidate_ends;
+	for (size_t i = 0; i < statuses.size(); ++i) {
+		copy_if(status_candidates[i].begin(), status_candidates[i].end(), back_inserter(candidates), [this, &document_predicate, status = statuses[i]](uint32_t ordinal) {
+			const DocumentData& document_data = documents_[ordinal];
+			return !IsRemovedPosting(ordinal, status) && document_predicate(document_data.id, document_data.status, document_data.rating);
+		});
+		candidate_ends.emplace_back(statuses[i], candidates.size());
+	}
+	profiler.EndStage("predicate"sv, candidates.size());
+	vector<double> relevances(candidates.size(), 0.0);
+	const auto add_relevance = [&candidates, &candidate_ends, &relevances, &budget, &profiler](string_view word, TermRole role, const PartitionedPostingList& postings, double inverse_document_freq) {
+		profiler.StartTerm(word, role, inverse_document_freq, postings.size());
+		size_t first = 0;
+		for (const auto& [status, last] : candidate_ends) {
+			const PostingList& partition = postings.GetPartition(status);
+			auto position = partition.begin();
+			size_t i = first;
+			for (; i < last && position != partition.end() && !(i % Budget::POSTING_BLOCK_SIZE == 0 && budget.IsExhausted()); ++i) {
+				position = partition.Seek(position, candidates[i]);
+				if (position != partition.end() && position->ordinal == candidates[i]) {
+					relevances[i] += position->term_freq * inverse_document_freq;
+				}
+			}
+			profiler.CountPostings(i - first);
+			first = last;
 		}
+		profiler.EndTerm();
+	};
+	for (const ScoredWord& scored_word : query.scored_words) {
+		add_relevance(scored_word.word->first, scored_word.role, scored_word.word->second, ComputeInverseDocumentFreq(scored_word.word->second.size()) * scored_word.weight);
 	}
-	vector<Document> matched_documents;
-	for (const auto [document_id, relevance] : document_to_relevance) {
-		matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+	ScoredDocuments scored_documents;
+	scored_documents.reserve(candidates.size());
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		scored_documents.emplace_back(candidates[i], relevances[i]);
+	}
+	profiler.EndStage("score"sv, scored_documents.size());
+	return scored_documents;
+}
+
+template <typename Profiler>
+void SearchServer::ExcludeMinusWords(const Query& query, ScoredDocuments& scored_documents, const Profiler& profiler) const {
+	const auto exclude = [this, &scored_documents, &profiler](std::string_view word, const PartitionedPostingList& postings) {
+		profiler.StartTerm(word, TermRole::MINUS, 0.0, postings.size());
+		const size_t scored_count = scored_documents.size();
+		// One forward cursor per status partition.
+		std::array<PostingList::const_iterator, DOCUMENT_STATUS_COUNT> positions;
+		for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+			positions[status] = postings.GetPartitions()[status].begin();
+		}
+		auto kept = scored_documents.begin();
+		for (const auto& scored_document : scored_documents) {
+			const DocumentStatus status = documents_[scored_document.first].status;
+			const PostingList& partition = postings.GetPartition(status);
+			auto& position = positions[static_cast<size_t>(status)];
+			position = partition.Seek(position, scored_document.first);
+			if (position == partition.end() || position->ordinal != scored_document.first) {
+				*kept++ = scored_document;
+			}
+		}
+		scored_documents.erase(kept, scored_documents.end());
+		profiler.CountPostings(scored_count);
+		profiler.CountExcluded(scored_count - scored_documents.size());
+		profiler.EndTerm();
+	};
+	for (const auto word : query.excluded_words) {
+		exclude(word->first, word->second);
 	}
-	return matched_documents;
 }
 
 template <typename ExecutionPolicy>
@@ -192,24 +1034,45 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 	if (raw_query.empty()) {
 		throw std::invalid_argument("empty request");
 	}
+	const uint32_t ordinal = document_ordinals_.at(document_id);
+	const DocumentStatus status = documents_[ordinal].status;
 	std::vector<std::string_view> matched_words;
 	Query processed_query = ParseQuery(raw_query);
-	std::for_each(policy, processed_query.plus_words.begin(), processed_query.plus_words.end(), [this, document_id, &matched_words](const std::string& word){
-		if (word_to_document_freqs_.count(word) == 0) {
+	const auto contains_document = [this, ordinal, status](std::string_view word) {
+		const auto postings = FindWord(word);
+		return postings != word_to_document_freqs_.end() && postings->second.Contains(ordinal, status);
+	};
+	bool is_excluded = std::any_of(policy, processed_query.excluded_words.begin(), processed_query.excluded_words.end(), [ordinal, status](const auto word) {
+		return word->second.Contains(ordinal, status);
+	});
+	is_excluded = is_excluded || !std::all_of(processed_query.required_words.begin(), processed_query.required_words.end(), contains_document);
+	if (is_excluded) {
+		return {matched_words, status};
+	}
+	std::for_each(policy, processed_query.plus_words.begin(), processed_query.plus_words.end(), [this, ordinal, status, &matched_words](std::string_view word){
+		const auto postings = FindWord(word);
+		if (postings == word_to_document_freqs_.end()) {
 			return;
 		}
-		if (word_to_document_freqs_.at(word).count(document_id)) {
-			matched_words.push_back(word_to_document_freqs_.find(word)->first);
+		if (postings->second.Contains(ordinal, status)) {
+			matched_words.push_back(postings->first);
 		}
 	});
-	std::for_each(policy, processed_query.minus_words.begin(), processed_query.minus_words.end(), [this, document_id, &matched_words](const std::string& word){
-		if (word_to_document_freqs_.count(word) == 0) {
-			return;
+	if (!processed_query.plus_prefixes.empty() || !processed_query.fuzzy_words.empty()) {
+		for (const ScoredWord& scored_word : processed_query.scored_words) {
+			if (scored_word.role != TermRole::PLUS && scored_word.word->second.Contains(ordinal, status)) {
+				matched_words.push_back(scored_word.word->first);
+			}
 		}
-		if (word_to_document_freqs_.at(word).count(document_id)) {
+		std::sort(matched_words.begin(), matched_words.end());
+		matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+	}
+	if (!matched_words.empty() && HasPositionalConstraints(processed_query)) {
+		ScoredDocuments scored_documents{{ordinal, 0.0}};
+		FilterByPositionalConstraints(processed_query, {status}, scored_documents);
+		if (scored_documents.empty()) {
 			matched_words.clear();
-			return;
 		}
-	});
-	return {matched_words, documents_.at(document_id).status};
+	}
+	return {matched_words, status};
 }
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Term dictionary: the words in byte order as contiguous arrays of views, for prefix ranges found by
+// binary search and for walks that seek by letter. New words go into a short sorted tail that is merged
+// into the main run once it outgrows the square root of it, so an insert moves O(sqrt(n)) entries on
+// average. Only views are stored; the words must outlive the dictionary.
+class TermDictionary {
+public:
+	using Run = std::pmr::vector<std::string_view>;
+
+	explicit TermDictionary(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : main_(resource), tail_(resource) {
+	}
+
+	// word must not be in the dictionary yet.
+	void Insert(std::string_view word) {
+		tail_.insert(std::upper_bound(tail_.begin(), tail_.end(), word), word);
+		if (tail_.size() * tail_.size() > std::max(main_.size(), MIN_MERGED_SIZE)) {
+			const auto middle = static_cast<ptrdiff_t>(main_.size());
+			main_.insert(main_.end(), tail_.begin(), tail_.end());
+			std::inplace_merge(main_.begin(), main_.begin() + middle, main_.end());
+			tail_.clear();
+		}
+	}
+
+	// Each run is sorted; together they hold every word once.
+	const Run& GetMainRun() const {
+		return main_;
+	}
+
+	const Run& GetTail() const {
+		return tail_;
+	}
+
+	// The words of run starting with prefix, a contiguous range.
+	static std::pair<Run::const_iterator, Run::const_iterator> PrefixRange(const Run& run, std::string_view prefix) {
+		const auto first = std::lower_bound(run.begin(), run.end(), prefix);
+		const auto last = std::partition_point(first, run.end(), [prefix](std::string_view word) {
+			return word.substr(0, prefix.size()) == prefix;
+		});
+		return {first, last};
+	}
+
+	size_t size() const {
+		return main_.size() + tail_.size();
+	}
+
+private:
+	// Lets the tail of a small dictionary reach 8 words before a merge.
+	static constexpr size_t MIN_MERGED_SIZE = 64;
+
+	Run main_;
+	Run tail_;
+};
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <atomic>
 #include <execution>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <thread>
 
+#include "corpus_loader.h"
+#include "latency_histogram.h"
 #include "search_server.h"
 
 void PrintDocument(const Document& document) {
@@ -214,6 +222,1121 @@ void TestRelevantCalculated() {
 	}
 }
 
+void TestPaginateSearch() {
+	using namespace std;
+	SearchServer server(""s);
+	server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+	server.AddDocument(2, "sun cat"s, DocumentStatus::ACTUAL, {3});
+	server.AddDocument(3, "dog hat"s, DocumentStatus::ACTUAL, {5, 2});
+	server.AddDocument(4, "bad cat walk"s, DocumentStatus::ACTUAL, {6, 1});
+	server.AddDocument(5, "cat war"s, DocumentStatus::ACTUAL, {7});
+	server.AddDocument(6, "cat war"s, DocumentStatus::ACTUAL, {7});
+	server.AddDocument(7, "city war"s, DocumentStatus::ACTUAL, {1});
+	server.AddDocument(8, "cat dog"s, DocumentStatus::BANNED, {2});
+
+	vector<int> expected;
+	for (const Document& document : server.FindTopDocumentsAfter("cat city"s, nullopt, 100)) {
+		expected.push_back(document.id);
+	}
+	ASSERT_EQUAL(expected.size(), 6u);
+
+	vector<int> paged;
+	size_t page_count = 0;
+	for (const vector<Document>& page : PaginateSearch(server, "cat city"s, 4)) {
+		ASSERT(page.size() <= 4u);
+		for (const Document& document : page) {
+			paged.push_back(document.id);
+		}
+		++page_count;
+	}
+	ASSERT_EQUAL(page_count, 2u);
+	ASSERT_EQUAL(paged, expected);
+
+	const auto after_second = server.FindTopDocumentsAfter("cat city"s, server.FindTopDocumentsAfter("cat city"s, nullopt, 2).back(), 2);
+	ASSERT_EQUAL(after_second.size(), 2u);
+	ASSERT_EQUAL(after_second[0].id, expected[2]);
+	ASSERT_EQUAL(after_second[1].id, expected[3]);
+	ASSERT_EQUAL(server.FindTopDocumentsAfter("cat"s, nullopt, 10, DocumentStatus::BANNED).size(), 1u);
+
+	const auto cat_pages = [&server]() {
+		vector<int> ids;
+		optional<Document> last;
+		for (auto page = server.FindTopDocumentsAfter("cat"s, last, 2); !page.empty(); page = server.FindTopDocumentsAfter("cat"s, last, 2)) {
+			for (const Document& document : page) {
+				ids.push_back(document.id);
+			}
+			last = page.back();
+		}
+		return ids;
+	};
+	const vector<int> scored_pages = cat_pages();
+	server.BuildImpactOrder(1);
+	ASSERT_EQUAL(cat_pages(), scored_pages);
+	int checked = 0;
+	const auto deep_page = server.FindTopDocumentsAfter("cat"s, server.FindTopDocuments("cat"s)[2], 1, [&checked](int document_id, DocumentStatus status, int rating) {
+		++checked;
+		return status == DocumentStatus::ACTUAL;
+	});
+	ASSERT_EQUAL(deep_page.front().id, scored_pages[3]);
+	ASSERT_HINT(checked <= 2, "Documents of earlier pages are skipped before the predicate"s);
+}
+
+void TestMemoryResource() {
+	using namespace std;
+	CountingResource upstream;
+	{
+		SearchServer server("in the"s, &upstream);
+		server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+		server.AddDocument(2, "sun cat"s, DocumentStatus::ACTUAL, {3});
+
+		const MemoryStats stats = server.GetMemoryStats();
+		ASSERT(stats.stop_words > 0);
+		ASSERT(stats.word_to_document_freqs > 0);
+		ASSERT(stats.word_index > 0);
+		ASSERT(stats.document_to_word_freqs > 0);
+		ASSERT(stats.documents > 0);
+		ASSERT(stats.document_ordinals > 0);
+		ASSERT_EQUAL(stats.fingerprints, 0u);
+		ASSERT(stats.document_ids > 0);
+		ASSERT_HINT(stats.GetTotalBytes() == upstream.GetAllocatedBytes(), "Index containers must allocate only from the given resource"s);
+
+		server.RemoveDocument(2);
+		ASSERT(server.GetMemoryStats().document_ordinals < stats.document_ordinals);
+		server.EnableDuplicateDetection(DuplicatePolicy::REPORT);
+		ASSERT(server.GetMemoryStats().fingerprints > 0);
+		ASSERT_EQUAL(server.GetMemoryStats().GetTotalBytes(), upstream.GetAllocatedBytes());
+		ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+	}
+	ASSERT_EQUAL(upstream.GetAllocatedBytes(), 0u);
+
+	pmr::monotonic_buffer_resource arena;
+	SearchServer server(""s, &arena);
+	server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+	ASSERT_EQUAL(server.FindTopDocuments("city"s).size(), 1u);
+}
+
+void TestPhraseAndProximity() {
+	using namespace std;
+	SearchServer server("in the"s);
+	server.EnablePositionalIndex();
+	server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+	server.AddDocument(2, "city cat"s, DocumentStatus::ACTUAL, {2});
+	server.AddDocument(3, "big cat walks around the old city"s, DocumentStatus::ACTUAL, {3});
+	server.AddDocument(4, "cat dog cat city"s, DocumentStatus::ACTUAL, {4});
+	server.RemoveDocument(4);
+	server.AddDocument(5, "cat dog cat city"s, DocumentStatus::ACTUAL, {5});
+
+	const auto ids = [&server](const string& query) {
+		set<int> result;
+		for (const Document& document : server.FindTopDocuments(query)) {
+			result.insert(document.id);
+		}
+		return result;
+	};
+
+	ASSERT_EQUAL(ids("cat city"s), (set<int>{1, 2, 3, 5}));
+	ASSERT_HINT(ids("\"cat in the city\""s) == (set<int>{1, 5}), "Stop words keep their slot but match any word"s);
+	ASSERT_EQUAL(ids("\"cat in the city\" -dog"s), set<int>{1});
+	ASSERT_EQUAL(ids("\"city cat\""s), set<int>{2});
+	ASSERT_EQUAL(ids("\"cat city\""s), set<int>{5});
+	ASSERT_EQUAL(ids("cat NEAR/1 city"s), (set<int>{2, 5}));
+	ASSERT_EQUAL(ids("cat NEAR/3 city"s), (set<int>{1, 2, 5}));
+	ASSERT_EQUAL(ids("cat NEAR/5 city -dog"s), (set<int>{1, 2, 3}));
+
+	ASSERT(get<vector<string_view>>(server.MatchDocument("\"city cat\""s, 1)).empty());
+	ASSERT_EQUAL(get<vector<string_view>>(server.MatchDocument("\"city cat\""s, 2)).size(), 2u);
+
+	SearchServer plain_server(""s);
+	plain_server.AddDocument(1, "cat city"s, DocumentStatus::ACTUAL, {1});
+	bool thrown = false;
+	try {
+		plain_server.FindTopDocuments("\"cat city\""s);
+	} catch (const logic_error&) {
+		thrown = true;
+	}
+	ASSERT_HINT(thrown, "Phrase queries need the positional index"s);
+}
+
+void TestPrefixQuery() {
+	using namespace std;
+	// Words inserted out of order land in the tail or the main run; a prefix range covers both.
+	vector<string> terms;
+	for (int i = 0; i < 300; ++i) {
+		terms.push_back("w"s + to_string(i * 7919 % 300));
+	}
+	TermDictionary dictionary;
+	for (const string& term : terms) {
+		dictionary.Insert(term);
+	}
+	ASSERT_EQUAL(dictionary.size(), 300u);
+	ASSERT(!dictionary.GetTail().empty() && dictionary.GetMainRun().size() > dictionary.GetTail().size());
+	for (const string& prefix : {"w1"s, "w29"s, "w2999"s, "w"s, "x"s}) {
+		vector<string_view> found;
+		for (const TermDictionary::Run* run : {&dictionary.GetMainRun(), &dictionary.GetTail()}) {
+			const auto [first, last] = TermDictionary::PrefixRange(*run, prefix);
+			found.insert(found.end(), first, last);
+		}
+		ASSERT_EQUAL(static_cast<size_t>(count_if(terms.begin(), terms.end(), [&prefix](const string& term) {
+			return term.compare(0, prefix.size(), prefix) == 0;
+		})), found.size());
+	}
+
+	SearchServer server("in the"s);
+	server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+	server.AddDocument(2, "cats and dogs"s, DocumentStatus::ACTUAL, {2});
+	server.AddDocument(3, "catalog of cities"s, DocumentStatus::ACTUAL, {3});
+	server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, {4});
+
+	const auto ids = [&server](const string& query) {
+		set<int> result;
+		for (const Document& document : server.FindTopDocuments(query)) {
+			result.insert(document.id);
+		}
+		return result;
+	};
+	ASSERT_EQUAL(ids("cat*"s), (set<int>{1, 2, 3}));
+	ASSERT_EQUAL(ids("cat* -cit*"s), set<int>{2});
+	ASSERT_EQUAL(ids("dog*"s), (set<int>{2, 4}));
+	ASSERT_EQUAL(get<vector<string_view>>(server.MatchDocument("cat* dogs"s, 2)), (vector<string_view>{"cats"sv, "dogs"sv}));
+	server.AddDocument(5, "catfish"s, DocumentStatus::ACTUAL, {5});
+	ASSERT_HINT(ids("cat*"s) == (set<int>{1, 2, 3, 5}), "New words must be visible to prefix queries"s);
+}
+
+void TestConjunctiveQuery() {
+	using namespace std;
+	PostingList postings;
+	for (uint32_t id = 0; id < 1000; id += 3) {
+		postings.Add(id, 1.0);
+	}
+	auto position = postings.begin();
+	for (uint32_t id = 0; id < 1000; id += 7) {
+		position = postings.Seek(position, id);
+		ASSERT(position == postings.LowerBound(id));
+	}
+	ASSERT(postings.Seek(postings.begin(), 5000) == postings.end());
+
+	SearchServer server("in the"s);
+	server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+	server.AddDocument(2, "cat and dog"s, DocumentStatus::ACTUAL, {2});
+	server.AddDocument(3, "city dog"s, DocumentStatus::ACTUAL, {3});
+	server.AddDocument(4, "cat dog city"s, DocumentStatus::ACTUAL, {4});
+	server.AddDocument(5, "cat dog city"s, DocumentStatus::BANNED, {5});
+
+	const auto relevance = [&server](const string& query) {
+		map<int, double> result;
+		for (const Document& document : server.FindTopDocuments(query)) {
+			result[document.id] = document.relevance;
+		}
+		return result;
+	};
+	const auto any_words = relevance("cat dog city"s);
+	const auto all_words = relevance("+cat +dog +city"s);
+	ASSERT_EQUAL(all_words.size(), 1u);
+	ASSERT(abs(all_words.at(4) - any_words.at(4)) < 1e-9);
+
+	const auto cat_and_any = relevance("+cat dog city"s);
+	ASSERT_EQUAL(cat_and_any.size(), 3u);
+	for (const auto [id, value] : cat_and_any) {
+		ASSERT_HINT(abs(value - any_words.at(id)) < 1e-9, "Optional words must still be scored"s);
+	}
+	ASSERT_EQUAL(relevance("+cat +dog -city"s).size(), 1u);
+	ASSERT(relevance("+cat +bird"s).empty());
+	ASSERT_EQUAL(server.FindTopDocuments("+cat +dog"s, DocumentStatus::BANNED).size(), 1u);
+
+	ASSERT(get<vector<string_view>>(server.MatchDocument("+cat city"s, 3)).empty());
+	ASSERT_EQUAL(get<vector<string_view>>(server.MatchDocument("+city cat"s, 3)).size(), 1u);
+}
+
+void TestLoadCorpus() {
+	using namespace std;
+	const string path = (filesystem::temp_directory_path() / "search_server_test_corpus.tsv"s).string();
+	{
+		ofstream out(path);
+		out << "1\tACTUAL\t1 2 3\tcat in the city\n"s;
+		out << "\n"s;
+		out << "2\tBANNED\t\tcity dog\r\n"s;
+		out << "3\tACTUAL\t-4 8\tcat"s;
+	}
+	SearchServer server("in the"s);
+	ASSERT_EQUAL(LoadCorpus(server, path), 3u);
+	ASSERT_EQUAL(server.GetDocumentCount(), 3);
+	ASSERT_EQUAL(server.FindTopDocuments("city"s).size(), 1u);
+	ASSERT_EQUAL(server.FindTopDocuments("dog"s, DocumentStatus::BANNED).size(), 1u);
+	ASSERT_EQUAL(server.FindTopDocuments("cat"s)[0].rating, 2);
+	ASSERT(server.GetMemoryStats().words > 0);
+
+	{
+		ofstream out(path);
+		out << "4\tACTUAL\t1\tcat\n5\tLOST\t1\tdog\n"s;
+	}
+	bool thrown = false;
+	try {
+		LoadCorpus(server, path);
+	} catch (const invalid_argument&) {
+		thrown = true;
+	}
+	ASSERT_HINT(thrown, "Malformed records must be reported"s);
+	filesystem::remove(path);
+}
+
+void TestQueryBudget() {
+	using namespace std;
+	SearchServer server(""s);
+	for (int id = 0; id < 10000; ++id) {
+		server.AddDocument(id, id % 2 == 0 ? "cat city"s : "cat"s, DocumentStatus::ACTUAL, {id % 7});
+	}
+
+	const SearchResult complete = server.FindTopDocumentsWithin("cat city"s, QueryBudget(chrono::seconds(60)));
+	ASSERT(!complete.is_partial);
+	const auto expected = server.FindTopDocuments("cat city"s);
+	ASSERT_EQUAL(complete.documents.size(), expected.size());
+	for (size_t i = 0; i < expected.size(); ++i) {
+		ASSERT_EQUAL(complete.documents[i].id, expected[i].id);
+	}
+
+	const SearchResult expired = server.FindTopDocumentsWithin("cat city"s, QueryBudget(QueryBudget::Clock::now() - chrono::seconds(1)));
+	ASSERT(expired.is_partial);
+	ASSERT(expired.documents.empty());
+
+	CancellationSource cancellation;
+	int checked = 0;
+	const SearchResult cancelled = server.FindTopDocumentsWithin("cat"s, QueryBudget(chrono::seconds(60), cancellation.GetToken()),
+			[&cancellation, &checked](int document_id, DocumentStatus status, int rating) {
+		if (++checked == 5000) {
+			cancellation.Cancel();
+		}
+		return true;
+	});
+	ASSERT(cancelled.is_partial);
+	ASSERT_HINT(checked == 2 * static_cast<int>(QueryBudget::POSTING_BLOCK_SIZE), "Cancellation is checked between posting blocks"s);
+	ASSERT_EQUAL(cancelled.documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+
+	auto future = server.FindTopDocumentsAsync("cat city"s, QueryBudget(chrono::seconds(60)));
+	const SearchResult async_result = future.get();
+	ASSERT(!async_result.is_partial);
+	ASSERT_EQUAL(async_result.documents[0].id, expected[0].id);
+}
+
+void TestDenseScoring() {
+	using namespace std;
+	SearchServer server("and"s);
+	for (int id = 0; id < 300; ++id) {
+		const string text = (id % 2 == 0 ? "cat "s : "dog "s) + (id % 3 == 0 ? "city "s : "village "s) + (id % 5 == 0 ? "catfish"s : "and"s);
+		server.AddDocument(1000 - id, text, id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 11});
+	}
+	server.RemoveDocument(1000);
+	server.RemoveDocument(998);
+	const auto compare = [&server](const string& query) {
+		const auto sequential = server.FindTopDocuments(execution::seq, query);
+		const auto parallel = server.FindTopDocuments(execution::par, query);
+		ASSERT_EQUAL(sequential.size(), parallel.size());
+		for (size_t i = 0; i < sequential.size(); ++i) {
+			ASSERT_EQUAL(sequential[i].id, parallel[i].id);
+			ASSERT(abs(sequential[i].relevance - parallel[i].relevance) < 1e-9);
+		}
+		return sequential;
+	};
+	compare("cat city"s);
+	compare("cat* -village"s);
+	compare("dog village -catfish"s);
+	const auto odd = compare("dog city"s);
+	ASSERT(!odd.empty());
+	ASSERT_HINT(server.FindTopDocuments("cat"s, [](int document_id, DocumentStatus, int) { return document_id > 990; }).size() == 3,
+			"Removed documents must not be scored"s);
+	// The accumulator is shared by every server on the thread.
+	SearchServer other(""s);
+	other.AddDocument(7, "cat"s, DocumentStatus::ACTUAL, {1});
+	const auto single = other.FindTopDocuments("cat"s);
+	ASSERT(single.size() == 1 && single[0].id == 7);
+	// A predicate that searches again must not disturb the query it was called from.
+	const auto nested = server.FindTopDocuments("cat city"s, [&server, &other](int, DocumentStatus status, int) {
+		return !server.FindTopDocuments("dog village"s).empty() && other.FindTopDocuments("cat"s).size() == 1 && status == DocumentStatus::ACTUAL;
+	});
+	const auto plain = server.FindTopDocuments("cat city"s);
+	ASSERT_EQUAL(nested.size(), plain.size());
+	for (size_t i = 0; i < plain.size(); ++i) {
+		ASSERT_EQUAL(nested[i].id, plain[i].id);
+		ASSERT_HINT(nested[i].relevance == plain[i].relevance, "Nested queries must not change relevance"s);
+	}
+	// Once removed documents outnumber the live ones their slots are dropped; results do not change.
+	SearchServer removing("and"s);
+	SearchServer kept("and"s);
+	for (int id = 0; id < 3000; ++id) {
+		const string text = (id % 2 == 0 ? "cat "s : "dog "s) + (id % 3 == 0 ? "city"s : "village"s);
+		removing.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 11});
+		if (id % 4 == 0) {
+			kept.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 11});
+		}
+	}
+	const size_t documents_bytes = removing.GetMemoryStats().documents;
+	for (int id = 0; id < 3000; ++id) {
+		if (id % 4 != 0) {
+			removing.RemoveDocument(id);
+		}
+	}
+	ASSERT(removing.GetMemoryStats().documents < documents_bytes);
+	for (const string& query : {"cat city"s, "dog -village"s, "cat dog"s}) {
+		const auto compacted = removing.FindTopDocuments(query);
+		const auto expected = kept.FindTopDocuments(query);
+		ASSERT_EQUAL(compacted.size(), expected.size());
+		for (size_t i = 0; i < expected.size(); ++i) {
+			ASSERT_EQUAL(compacted[i].id, expected[i].id);
+			ASSERT_EQUAL(compacted[i].relevance, expected[i].relevance);
+		}
+	}
+	removing.AddDocument(5000, "cat city"s, DocumentStatus::ACTUAL, {100});
+	ASSERT_EQUAL(removing.FindTopDocuments("cat city"s).front().id, 5000);
+}
+
+void TestRemovedPostings() {
+	using namespace std;
+	const auto make_text = [](int id) {
+		return (id % 2 == 0 ? "cat "s : "dog "s) + (id % 3 == 0 ? "in city "s : "in village "s) + "w"s + to_string(id % 17);
+	};
+	const auto make_server = []() {
+		SearchServer server("and"s);
+		server.EnablePositionalIndex();
+		return server;
+	};
+	SearchServer removing = make_server();
+	SearchServer kept = make_server();
+	for (int id = 0; id < 1500; ++id) {
+		const DocumentStatus status = id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+		removing.AddDocument(id, make_text(id), status, {id % 11});
+		if (id % 3 != 0) {
+			kept.AddDocument(id, make_text(id), status, {id % 11});
+		}
+	}
+	removing.BuildImpactOrder(100);
+	kept.BuildImpactOrder(100);
+	for (int id = 0; id < 1500; id += 3) {
+		removing.RemoveDocument(id);
+	}
+	// Removed postings stay in the lists until compaction, but no query path may see them.
+	const vector<string> queries = {"cat"s, "cat village -w3"s, "+dog +village w5"s, "\"in city\" cat"s, "w1* dog"s};
+	const auto compare = [](const vector<Document>& found, const vector<Document>& expected) {
+		ASSERT_EQUAL(found.size(), expected.size());
+		for (size_t i = 0; i < expected.size(); ++i) {
+			ASSERT_EQUAL(found[i].id, expected[i].id);
+			ASSERT(abs(found[i].relevance - expected[i].relevance) < 1e-9);
+		}
+	};
+	for (const string& query : queries) {
+		compare(removing.FindTopDocuments(query), kept.FindTopDocuments(query));
+		compare(removing.FindTopDocuments(execution::par, query), kept.FindTopDocuments(execution::par, query));
+		compare(removing.FindTopDocuments(query, DocumentStatus::BANNED), kept.FindTopDocuments(query, DocumentStatus::BANNED));
+	}
+	const auto removing_batch = ProcessQueries(removing, queries);
+	const auto kept_batch = ProcessQueries(kept, queries);
+	for (size_t i = 0; i < queries.size(); ++i) {
+		compare(removing_batch[i], kept_batch[i]);
+	}
+	removing.ReorderDocuments();
+	for (const string& query : queries) {
+		compare(removing.FindTopDocuments(query), kept.FindTopDocuments(query));
+	}
+}
+
+void TestReorderDocuments() {
+	using namespace std;
+	// Four topics with their own words, documents of different topics interleaved.
+	vector<vector<uint32_t>> document_terms;
+	uint32_t random = 12345;
+	for (uint32_t i = 0; i < 400; ++i) {
+		random = random * 1103515245 + 12345;
+		const uint32_t topic = (random >> 16) % 4;
+		set<uint32_t> terms;
+		for (uint32_t j = 0; j < 5; ++j) {
+			random = random * 1103515245 + 12345;
+			terms.insert(topic * 10 + (random >> 16) % 10);
+		}
+		document_terms.emplace_back(terms.begin(), terms.end());
+	}
+	const auto compute_gap_cost = [&document_terms](const vector<uint32_t>& order) {
+		vector<vector<uint32_t>> postings(40);
+		for (uint32_t ordinal = 0; ordinal < order.size(); ++ordinal) {
+			for (const uint32_t term : document_terms[order[ordinal]]) {
+				postings[term].push_back(ordinal);
+			}
+		}
+		double cost = 0.0;
+		for (const auto& list : postings) {
+			for (size_t i = 1; i < list.size(); ++i) {
+				cost += log2(list[i] - list[i - 1]);
+			}
+		}
+		return cost;
+	};
+	vector<uint32_t> identity(document_terms.size());
+	iota(identity.begin(), identity.end(), 0);
+	const auto order = ComputeBisectionOrder(document_terms, 40);
+	ASSERT_EQUAL(set<uint32_t>(order.begin(), order.end()).size(), document_terms.size());
+	ASSERT_HINT(compute_gap_cost(order) < compute_gap_cost(identity) * 0.7, "Reordering must shorten posting gaps"s);
+
+	SearchServer server("in the"s);
+	server.EnablePositionalIndex();
+	const vector<string> words = {"cat"s, "dog"s, "city"s, "village"s, "catfish"s, "bird"s};
+	for (int id = 0; id < 200; ++id) {
+		string text = words[id % 6] + " in the "s + words[(id * 7) % 6] + " "s + words[(id / 3) % 6];
+		server.AddDocument(id * 3, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 9, 1});
+	}
+	server.RemoveDocument(30);
+	server.RemoveDocument(300);
+	const vector<string> queries = {"cat city"s, "cat* -dog"s, "+city bird"s, "\"cat in the city\""s, "dog NEAR/2 village"s, "village -cat*"s};
+	const auto run = [&server, &queries]() {
+		vector<vector<Document>> results;
+		for (const string& query : queries) {
+			results.push_back(server.FindTopDocuments(query));
+			results.push_back(server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED));
+		}
+		return results;
+	};
+	const auto before = run();
+	const auto [words_before, status_before] = server.MatchDocument("cat city -village"s, 33);
+	server.ReorderDocuments();
+	const auto after = run();
+	ASSERT_EQUAL(before.size(), after.size());
+	for (size_t i = 0; i < before.size(); ++i) {
+		ASSERT_EQUAL(before[i].size(), after[i].size());
+		for (size_t j = 0; j < before[i].size(); ++j) {
+			ASSERT_EQUAL(before[i][j].id, after[i][j].id);
+			ASSERT(abs(before[i][j].relevance - after[i][j].relevance) < 1e-9);
+		}
+	}
+	const auto [words_after, status_after] = server.MatchDocument("cat city -village"s, 33);
+	ASSERT(words_before == words_after && status_before == status_after);
+	ASSERT_EQUAL(server.GetDocumentCount(), 198);
+	server.AddDocument(1000, "cat in the city"s, DocumentStatus::ACTUAL, {10});
+	ASSERT_EQUAL(server.FindTopDocuments("\"cat in the city\""s).size(), before[6].size() + 1);
+}
+
+void TestBatchQueries() {
+	using namespace std;
+	SearchServer server("and in the"s);
+	server.EnablePositionalIndex();
+	const vector<string> words = {"cat"s, "dog"s, "city"s, "village"s, "catfish"s, "bird"s, "cattle"s};
+	// More documents than the score window of a full chunk, so scoring spans several windows.
+	for (int id = 0; id < 2500; ++id) {
+		const string text = words[id % 7] + " and "s + words[(id * 5) % 7] + " in the "s + words[(id / 7) % 7] + " "s + words[(id / 3) % 7];
+		server.AddDocument(id, text, id % 6 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 13});
+	}
+	vector<string> queries = {"cat city"s, "cat* -dog"s, "cat cat* bird"s, "+city bird"s, "\"dog in the city\""s, "village -cat*"s, "unknown"s, "-cat"s};
+	for (int i = 0; i < 2000; ++i) {
+		queries.push_back(words[i % 7] + " "s + words[(i / 7) % 7] + (i % 3 == 0 ? " -"s + words[(i / 3) % 7] : ""s));
+	}
+	const auto batch = ProcessQueries(server, queries);
+	ASSERT_EQUAL(batch.size(), queries.size());
+	for (size_t i = 0; i < queries.size(); ++i) {
+		const auto single = server.FindTopDocuments(queries[i]);
+		ASSERT_EQUAL(batch[i].size(), single.size());
+		for (size_t j = 0; j < single.size(); ++j) {
+			ASSERT_EQUAL(batch[i][j].id, single[j].id);
+			ASSERT_HINT(batch[i][j].relevance == single[j].relevance, "Batched relevance must be bit-identical"s);
+			ASSERT_EQUAL(batch[i][j].rating, single[j].rating);
+		}
+	}
+	const auto banned = server.FindTopDocumentsBatch({"cat dog"s}, DocumentStatus::BANNED);
+	ASSERT(!banned[0].empty() && banned[0][0].id % 6 == 0);
+	bool thrown = false;
+	try {
+		ProcessQueries(server, {"cat"s, "--dog"s});
+	} catch (const invalid_argument&) {
+		thrown = true;
+	}
+	ASSERT(thrown);
+}
+
+void TestImpactOrder() {
+	using namespace std;
+	SearchServer server(""s);
+	const vector<string> fillers = {"dog"s, "city"s, "village"s, "bird"s};
+	for (int id = 0; id < 3000; ++id) {
+		string text = "cat"s;
+		for (int i = 0; i < id % 9; ++i) {
+			text += " "s + fillers[(id + i) % 4];
+		}
+		server.AddDocument(id, text, id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 17});
+	}
+	server.AddDocument(5000, "bird"s, DocumentStatus::ACTUAL, {1});
+	const vector<string> queries = {"cat"s, "cat -dog"s, "cat -vil*"s, "cat dog"s, "bird"s};
+	vector<vector<Document>> expected;
+	for (const string& query : queries) {
+		expected.push_back(server.FindTopDocuments(query));
+	}
+	const auto banned_expected = server.FindTopDocuments("cat"s, DocumentStatus::BANNED);
+
+	server.BuildImpactOrder(100);
+	ASSERT(server.GetMemoryStats().impact_postings > 0);
+	const auto compare = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+		ASSERT_EQUAL(lhs.size(), rhs.size());
+		for (size_t i = 0; i < lhs.size(); ++i) {
+			ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+			ASSERT_EQUAL(lhs[i].relevance, rhs[i].relevance);
+		}
+	};
+	for (size_t i = 0; i < queries.size(); ++i) {
+		compare(server.FindTopDocuments(queries[i]), expected[i]);
+		compare(server.FindTopDocuments(execution::par, queries[i]), expected[i]);
+	}
+	compare(server.FindTopDocuments("cat"s, DocumentStatus::BANNED), banned_expected);
+	int checked = 0;
+	server.FindTopDocuments("cat"s, [&checked](int document_id, DocumentStatus status, int rating) {
+		++checked;
+		return status == DocumentStatus::ACTUAL;
+	});
+	ASSERT_HINT(checked < 100, "A single-word query must stop early"s);
+
+	server.ReorderDocuments();
+	compare(server.FindTopDocuments("cat -dog"s), expected[1]);
+	server.AddDocument(6000, "cat"s, DocumentStatus::ACTUAL, {100});
+	ASSERT_EQUAL(server.FindTopDocuments("cat"s).front().id, 6000);
+	checked = 0;
+	server.FindTopDocuments("cat"s, [&checked](int document_id, DocumentStatus status, int rating) {
+		++checked;
+		return true;
+	});
+	ASSERT_HINT(checked < 100, "Added documents must keep the impact order"s);
+	server.RemoveDocument(6000);
+	compare(server.FindTopDocuments("cat"s), expected[0]);
+	checked = 0;
+	server.FindTopDocuments("cat"s, [&checked](int document_id, DocumentStatus status, int rating) {
+		++checked;
+		return status == DocumentStatus::ACTUAL;
+	});
+	ASSERT_HINT(checked < 100, "Removed documents must keep the impact order"s);
+
+	// Enough new documents to merge the tails, and documents moving away and back, against a server
+	// scoring the same documents without the copies.
+	SearchServer plain(""s);
+	for (int id = 0; id < 3000; ++id) {
+		string text = "cat"s;
+		for (int i = 0; i < id % 9; ++i) {
+			text += " "s + fillers[(id + i) % 4];
+		}
+		plain.AddDocument(id, text, id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 17});
+	}
+	plain.AddDocument(5000, "bird"s, DocumentStatus::ACTUAL, {1});
+	for (int id = 7000; id < 7400; ++id) {
+		const string text = id % 3 == 0 ? "cat"s : "cat bird dog"s;
+		server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 23});
+		plain.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 23});
+	}
+	for (int id = 1; id < 3000; id += 7) {
+		server.SetDocumentStatus(id, DocumentStatus::IRRELEVANT);
+		plain.SetDocumentStatus(id, DocumentStatus::IRRELEVANT);
+		if (id % 2 == 0) {
+			server.SetDocumentStatus(id, DocumentStatus::ACTUAL);
+			plain.SetDocumentStatus(id, DocumentStatus::ACTUAL);
+		}
+	}
+	for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED}) {
+		for (const string& query : {"cat"s, "cat -dog"s}) {
+			compare(server.FindTopDocuments(query, status), plain.FindTopDocuments(query, status));
+		}
+	}
+	const optional<Document> last = server.FindTopDocuments("cat"s).back();
+	compare(server.FindTopDocumentsAfter("cat"s, last, 20), plain.FindTopDocumentsAfter("cat"s, last, 20));
+	checked = 0;
+	server.FindTopDocuments("cat"s, [&checked](int document_id, DocumentStatus status, int rating) {
+		++checked;
+		return true;
+	});
+	ASSERT_HINT(checked < 100, "Merged tails must keep the impact order"s);
+}
+
+void TestDuplicateDetection() {
+	using namespace std;
+	SearchServer server("and with"s);
+	server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+	vector<pair<int, int>> reported;
+	server.EnableDuplicateDetection(DuplicatePolicy::REPORT, [&reported](int duplicate_id, int original_id) {
+		reported.emplace_back(duplicate_id, original_id);
+	});
+	server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+	server.AddDocument(3, "funny pet and curly hair"s, DocumentStatus::ACTUAL, {1, 2});
+	server.AddDocument(5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, {1, 2});
+	server.AddDocument(8, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, {1, 2});
+	ASSERT((reported == vector<pair<int, int>>{{3, 2}, {5, 1}}));
+	ASSERT_EQUAL(server.GetDocumentCount(), 5);
+
+	server.EnableDuplicateDetection(DuplicatePolicy::KEEP_OLDEST);
+	server.AddDocument(6, "rat nasty pet funny"s, DocumentStatus::ACTUAL, {1, 2});
+	ASSERT_EQUAL(server.GetDocumentCount(), 5);
+	ASSERT(server.FindTopDocuments("nasty"s).size() == 2);
+
+	server.EnableDuplicateDetection(DuplicatePolicy::REJECT);
+	bool thrown = false;
+	try {
+		server.AddDocument(9, "hair curly pet funny"s, DocumentStatus::ACTUAL, {1});
+	} catch (const invalid_argument&) {
+		thrown = true;
+	}
+	ASSERT(thrown);
+	server.RemoveDocument(2);
+	server.RemoveDocument(3);
+	server.AddDocument(9, "hair curly pet funny"s, DocumentStatus::ACTUAL, {1});
+	ASSERT_HINT(server.GetDocumentCount() == 4, "Removed documents must leave the fingerprint index"s);
+}
+
+void TestLatencyHistogram() {
+	using namespace std;
+	LatencyHistogram histogram;
+	for (uint64_t value = 1; value <= 100000; ++value) {
+		histogram.Record(value * 1000);
+	}
+	ASSERT_EQUAL(histogram.GetTotalCount(), 100000u);
+	for (const double percentile : {50.0, 90.0, 99.0, 99.9}) {
+		const double expected = percentile * 1000.0 * 1000.0;
+		ASSERT_HINT(abs(histogram.GetValueAtPercentile(percentile) - expected) < expected / LatencyHistogram::SUB_BUCKET_COUNT, "Percentiles must be within the bucket precision"s);
+	}
+	ASSERT_EQUAL(histogram.GetValueAtPercentile(100.0), 100000u * 1000u);
+
+	LatencyHistogram corrected;
+	corrected.RecordCorrected(1000, 100);
+	ASSERT_EQUAL(corrected.GetTotalCount(), 10u);
+	corrected.RecordCorrected(50, 100);
+	ASSERT_EQUAL(corrected.GetTotalCount(), 11u);
+	LatencyHistogram closed_loop;
+	closed_loop.Record(100, 9);
+	closed_loop.Record(1000);
+	ASSERT_EQUAL(closed_loop.GetValueAtPercentile(90.0), 100u);
+	const LatencyHistogram closed_loop_corrected = closed_loop.GetCorrectedCopy(100);
+	ASSERT_EQUAL(closed_loop_corrected.GetTotalCount(), 19u);
+	ASSERT_HINT(closed_loop_corrected.GetValueAtPercentile(90.0) > 500, "A stall must show up in the corrected percentiles"s);
+	closed_loop.Merge(corrected);
+	ASSERT_EQUAL(closed_loop.GetTotalCount(), 21u);
+}
+
+void TestFuzzyMatching() {
+	using namespace std;
+	const auto edit_distance = [](const string& lhs, const string& rhs) {
+		vector<size_t> row(rhs.size() + 1);
+		iota(row.begin(), row.end(), 0);
+		for (size_t i = 0; i < lhs.size(); ++i) {
+			vector<size_t> next(rhs.size() + 1, i + 1);
+			for (size_t j = 0; j < rhs.size(); ++j) {
+				next[j + 1] = min({row[j] + (lhs[i] == rhs[j] ? 0 : 1), row[j + 1] + 1, next[j] + 1});
+			}
+			row = move(next);
+		}
+		return row.back();
+	};
+	// Fuzzy expansion must find exactly the words with the query's first letter that a brute-force scan finds,
+	// including words added after fuzzy matching was turned on.
+	SearchServer server(""s);
+	vector<string> words;
+	uint32_t random = 7;
+	for (int id = 0; id < 1500; ++id) {
+		if (id == 500) {
+			server.SetFuzzyMatching(2);
+		}
+		random = random * 1103515245 + 12345;
+		string word;
+		for (uint32_t length = 3 + (random >> 16) % 6, i = 0; i < length; ++i) {
+			random = random * 1103515245 + 12345;
+			word += static_cast<char>('a' + (random >> 16) % 4);
+		}
+		words.push_back(word);
+		server.AddDocument(id, word, DocumentStatus::ACTUAL, {id % 5});
+	}
+	for (const string& query : {"abcd"s, "aabbcc"s, "dddddddd"s, "abc"s, "ba"s}) {
+		const size_t max_edits = query.size() < 3 ? 0 : query.size() < 6 ? 1 : 2;
+		for (int id = 0; id < static_cast<int>(words.size()); ++id) {
+			const auto [matched_words, status] = server.MatchDocument(query, id);
+			ASSERT_EQUAL(!matched_words.empty(), words[id][0] == query[0] && edit_distance(query, words[id]) <= max_edits);
+		}
+	}
+	// Short ranges are scanned and long ones walked; both find what a brute-force scan finds.
+	vector<string> dictionary;
+	for (int i = 0; i < 4000; ++i) {
+		random = random * 1103515245 + 12345;
+		string word;
+		for (uint32_t length = 2 + (random >> 16) % 7, j = 0; j < length; ++j) {
+			random = random * 1103515245 + 12345;
+			word += static_cast<char>('a' + (random >> 16) % 4);
+		}
+		dictionary.push_back(word);
+	}
+	sort(dictionary.begin(), dictionary.end());
+	dictionary.erase(unique(dictionary.begin(), dictionary.end()), dictionary.end());
+	ASSERT(dictionary.size() > LevenshteinAutomaton::SCAN_MAX_WORDS);
+	for (const size_t size : {size_t{100}, dictionary.size()}) {
+		for (const int max_edits : {1, 2}) {
+			const string query = "abcdab"s;
+			const LevenshteinAutomaton automaton(query, max_edits);
+			vector<pair<string_view, int>> found;
+			automaton.ForEachMatch(dictionary.begin(), dictionary.begin() + size, [&found](string_view word, int distance) {
+				found.emplace_back(word, distance);
+			});
+			vector<pair<string_view, int>> expected;
+			for (size_t i = 0; i < size; ++i) {
+				const size_t distance = edit_distance(query, dictionary[i]);
+				if (distance <= static_cast<size_t>(max_edits)) {
+					expected.emplace_back(dictionary[i], static_cast<int>(distance));
+				}
+			}
+			ASSERT(found == expected);
+		}
+	}
+
+	SearchServer typo_server("in the"s);
+	typo_server.AddDocument(1, "elephant in the city"s, DocumentStatus::ACTUAL, {1});
+	typo_server.AddDocument(2, "cart"s, DocumentStatus::ACTUAL, {2});
+	typo_server.AddDocument(3, "cat"s, DocumentStatus::ACTUAL, {3});
+	typo_server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, {4});
+	ASSERT(typo_server.FindTopDocuments("elephnt"s).empty());
+	typo_server.SetFuzzyMatching(2, 0.5);
+	const auto exact = typo_server.FindTopDocuments("cart"s);
+	const auto fuzzy = typo_server.FindTopDocuments("cat"s);
+	ASSERT_EQUAL(fuzzy.size(), 2u);
+	ASSERT_EQUAL(fuzzy[0].id, 3);
+	ASSERT_EQUAL(fuzzy[1].id, 2);
+	ASSERT(abs(fuzzy[1].relevance - exact[0].relevance * 0.5) < 1e-9);
+	ASSERT_EQUAL(typo_server.FindTopDocuments("elephnt"s).front().id, 1);
+	ASSERT(typo_server.FindTopDocuments("cat -dg"s).size() == 2);
+	const auto conjunctive = typo_server.FindTopDocuments("+cart cat"s);
+	ASSERT_HINT(conjunctive.size() == 1 && conjunctive[0].relevance == exact[0].relevance, "Words of the query are not scored again as typos"s);
+	const vector<string> queries = {"cat"s, "elephnt city"s, "crt dog"s};
+	const auto batch = ProcessQueries(typo_server, queries);
+	for (size_t i = 0; i < queries.size(); ++i) {
+		const auto sequential = typo_server.FindTopDocuments(queries[i]);
+		const auto parallel = typo_server.FindTopDocuments(execution::par, queries[i]);
+		ASSERT_EQUAL(sequential.size(), parallel.size());
+		ASSERT_EQUAL(sequential.size(), batch[i].size());
+		for (size_t j = 0; j < sequential.size(); ++j) {
+			ASSERT_EQUAL(sequential[j].id, parallel[j].id);
+			ASSERT_EQUAL(sequential[j].relevance, batch[i][j].relevance);
+		}
+	}
+	typo_server.SetFuzzyMatching(0);
+	ASSERT(typo_server.FindTopDocuments("elephnt"s).empty());
+	ASSERT_HINT(typo_server.GetMemoryStats().term_dictionary > 0, "Prefix queries keep the term dictionary"s);
+}
+
+void TestConcurrentIngest() {
+	using namespace std;
+	const auto make_text = [](int id) {
+		return "w"s + to_string(id % 50) + " w"s + to_string(id % 7) + " w"s + to_string(id % 3) + " x"s + to_string(id % 11);
+	};
+	SearchServer sequential(""s);
+	SearchServer concurrent(""s);
+	sequential.AddDocument(0, make_text(0), DocumentStatus::ACTUAL, {0});
+	concurrent.AddDocument(0, make_text(0), DocumentStatus::ACTUAL, {0});
+	const int thread_count = 8;
+	const int document_count = 2000;
+	// Every thread tries every id: each id must be accepted exactly once, also while its first copy is staged.
+	vector<atomic<int>> accepted(document_count);
+	vector<thread> producers;
+	for (int t = 0; t < thread_count; ++t) {
+		producers.emplace_back([&, t]() {
+			for (int i = 0; i < document_count; ++i) {
+				const int id = (i + t * 97) % document_count;
+				try {
+					concurrent.AddDocumentConcurrently(id, make_text(id), DocumentStatus::ACTUAL, {id % 10});
+					++accepted[id];
+				} catch (const invalid_argument&) {
+				}
+			}
+		});
+	}
+	for (thread& producer : producers) {
+		producer.join();
+	}
+	concurrent.FlushIngest();
+	ASSERT_EQUAL(accepted[0].load(), 0);
+	for (int id = 1; id < document_count; ++id) {
+		ASSERT_EQUAL(accepted[id].load(), 1);
+		sequential.AddDocument(id, make_text(id), DocumentStatus::ACTUAL, {id % 10});
+	}
+	ASSERT_EQUAL(concurrent.GetDocumentCount(), document_count);
+	for (const string& query : {"w1 x3"s, "w49 -w0"s, "x10 w2 w5"s}) {
+		const auto expected = sequential.FindTopDocuments(query);
+		const auto found = concurrent.FindTopDocuments(query);
+		ASSERT_EQUAL(found.size(), expected.size());
+		for (size_t i = 0; i < found.size(); ++i) {
+			ASSERT_EQUAL(found[i].id, expected[i].id);
+			ASSERT_EQUAL(found[i].relevance, expected[i].relevance);
+		}
+	}
+
+	bool thrown = false;
+	try {
+		concurrent.AddDocumentConcurrently(document_count, "bad wo\x12rd"s, DocumentStatus::ACTUAL, {1});
+	} catch (const invalid_argument&) {
+		thrown = true;
+	}
+	ASSERT(thrown);
+	concurrent.AddDocumentConcurrently(document_count, make_text(1), DocumentStatus::ACTUAL, {1});
+	ASSERT_EQUAL(concurrent.GetDocumentCount(), document_count);
+	concurrent.FlushIngest();
+	ASSERT_HINT(concurrent.GetDocumentCount() == document_count + 1, "A document whose words were invalid must not keep its id"s);
+
+	// Every text is added twice: one copy of each is kept, the other is rejected at merge time and reported.
+	SearchServer rejecting(""s);
+	rejecting.EnableDuplicateDetection(DuplicatePolicy::REJECT);
+	vector<thread> duplicate_producers;
+	for (int t = 0; t < 4; ++t) {
+		duplicate_producers.emplace_back([&rejecting, t]() {
+			for (int id = t; id < 1200; id += 4) {
+				rejecting.AddDocumentConcurrently(id, "d"s + to_string(id % 600) + " common"s, DocumentStatus::ACTUAL, {1});
+			}
+		});
+	}
+	for (thread& producer : duplicate_producers) {
+		producer.join();
+	}
+	const vector<int> rejected = rejecting.FlushIngest();
+	ASSERT_EQUAL(rejected.size(), 600u);
+	ASSERT_EQUAL(rejecting.GetDocumentCount(), 600);
+	set<int> kept_texts;
+	for (const int id : rejecting) {
+		kept_texts.insert(id % 600);
+	}
+	ASSERT_EQUAL(kept_texts.size(), 600u);
+	for (const int id : rejected) {
+		ASSERT(find(rejecting.begin(), rejecting.end(), id) == rejecting.end());
+	}
+	ASSERT(rejecting.FlushIngest().empty());
+
+	// Skipped copies are reported the same way.
+	SearchServer keeping(""s);
+	keeping.EnableDuplicateDetection(DuplicatePolicy::KEEP_OLDEST);
+	for (int id = 0; id < 1200; ++id) {
+		keeping.AddDocumentConcurrently(id, "d"s + to_string(id % 600) + " common"s, DocumentStatus::ACTUAL, {1});
+	}
+	const vector<int> skipped = keeping.FlushIngest();
+	ASSERT_EQUAL(skipped.size(), 600u);
+	ASSERT_EQUAL(keeping.GetDocumentCount(), 600);
+	for (size_t i = 0; i < skipped.size(); ++i) {
+		ASSERT_EQUAL(skipped[i], static_cast<int>(600 + i));
+	}
+}
+
+void TestHashedLookups() {
+	using namespace std;
+	vector<string> keys;
+	for (int i = 0; i < 1000; ++i) {
+		keys.push_back("key"s + to_string(i * 7));
+	}
+	const PerfectHashSet set(keys);
+	HashedWordIndex<int> index;
+	for (size_t i = 0; i < keys.size(); ++i) {
+		index.Insert(keys[i], static_cast<int>(i));
+	}
+	ASSERT_EQUAL(index.size(), keys.size());
+	for (size_t i = 0; i < keys.size(); ++i) {
+		ASSERT(set.Contains(keys[i]));
+		ASSERT(index.Find(keys[i]) && *index.Find(keys[i]) == static_cast<int>(i));
+	}
+	for (int i = 0; i < 7000; ++i) {
+		const string key = "key"s + to_string(i);
+		ASSERT_EQUAL(set.Contains(key), i % 7 == 0);
+		ASSERT_EQUAL(index.Find(key) != nullptr, i % 7 == 0);
+	}
+	ASSERT(!PerfectHashSet(vector<string>{}).Contains(""s));
+
+	SearchServer server("and in at"s);
+	server.AddDocument(1, "curly cat and curly tail"s, DocumentStatus::ACTUAL, {7});
+	server.AddDocument(2, "dog in the town"s, DocumentStatus::ACTUAL, {1});
+	ASSERT(server.FindTopDocuments("and in at"s).empty());
+	ASSERT(server.FindTopDocuments("unknown absent words"s).empty());
+	ASSERT_EQUAL(server.FindTopDocuments("unknown cat -absent"s).size(), 1u);
+	ASSERT(server.FindTopDocuments("cat -curly"s).empty());
+	const auto [words, status] = server.MatchDocument("curly missing and"s, 1);
+	ASSERT(words == vector<string_view>{"curly"sv});
+	// The stop word table owns its keys, so a moved server still recognises stop words.
+	optional<SearchServer> moved;
+	moved.emplace(move(server));
+	moved->AddDocument(3, "cat at the gate and in town"s, DocumentStatus::ACTUAL, {3});
+	ASSERT(moved->FindTopDocuments("and in at"s).empty());
+	ASSERT_EQUAL(moved->FindTopDocuments("cat"s).size(), 2u);
+	ASSERT_EQUAL(get<0>(moved->MatchDocument("gate and at"s, 3)), vector<string_view>{"gate"sv});
+}
+
+void TestMemoryIntrospection() {
+	using namespace std;
+	SearchServer server("in the"s);
+	server.EnablePositionalIndex();
+	for (int id = 0; id < 300; ++id) {
+		server.AddDocument(id, "cat in the city "s + (id % 3 == 0 ? "dog"s : "bird"s) + (id == 7 ? " rare"s : ""s), DocumentStatus::ACTUAL, {1});
+	}
+	const TermMemory cat = server.GetTermMemory("cat"s);
+	ASSERT_EQUAL(cat.word, "cat"sv);
+	ASSERT_EQUAL(cat.document_count, 300u);
+	ASSERT(cat.bytes >= 300 * sizeof(Posting));
+	ASSERT_EQUAL(server.GetTermMemory("rare"s).document_count, 1u);
+	ASSERT_EQUAL(server.GetTermMemory("missing"s).bytes, 0u);
+	ASSERT_EQUAL(server.GetTermMemory("in"s).bytes, 0u);
+
+	const auto largest = server.GetLargestTerms(3);
+	ASSERT_EQUAL(largest.size(), 3u);
+	ASSERT(largest[0].bytes >= largest[1].bytes && largest[1].bytes >= largest[2].bytes);
+	ASSERT(largest[0].word == "cat"sv || largest[0].word == "city"sv);
+	ASSERT_EQUAL(largest[2].word, "bird"sv);
+	ASSERT_EQUAL(server.GetLargestTerms(100).size(), 5u);
+	ASSERT(server.GetLargestTerms(0).empty());
+
+	const MemoryStats stats = server.GetMemoryStats();
+	ASSERT(stats.word_arena_slack < stats.words);
+	ASSERT_EQUAL(stats.GetAllocatorOverheadEstimate(), stats.allocation_count * MemoryStats::ALLOCATION_OVERHEAD);
+	ostringstream out;
+	out << stats;
+	ASSERT(out.str().find("total = "s + to_string(stats.GetTotalBytes())) != string::npos);
+}
+
+void TestExplainMode() {
+	using namespace std;
+	SearchServer server("and"s);
+	server.AddDocument(1, "white cat and dog"s, DocumentStatus::ACTUAL, {8});
+	server.AddDocument(2, "fluffy cat"s, DocumentStatus::ACTUAL, {7});
+	server.AddDocument(3, "groomed dog"s, DocumentStatus::BANNED, {5});
+	server.AddDocument(4, "catfish and cat"s, DocumentStatus::ACTUAL, {3});
+	const auto find_term = [](const QueryExplanation& explanation, const string& word) {
+		return *find_if(explanation.terms.begin(), explanation.terms.end(), [&word](const TermExplanation& term) { return term.word == word; });
+	};
+
+	const QueryExplanation dense = server.ExplainTopDocuments("cat -white groomed"s);
+	const auto expected = server.FindTopDocuments("cat -white groomed"s);
+	ASSERT_EQUAL(dense.path, "dense"s);
+	ASSERT_EQUAL(dense.documents.size(), expected.size());
+	for (size_t i = 0; i < expected.size(); ++i) {
+		ASSERT_EQUAL(dense.documents[i].id, expected[i].id);
+		ASSERT_EQUAL(dense.documents[i].relevance, expected[i].relevance);
+	}
+	const TermExplanation cat = find_term(dense, "cat"s);
+	ASSERT(cat.role == TermRole::PLUS);
+	ASSERT_EQUAL(cat.posting_count, 3u);
+	ASSERT_EQUAL(cat.postings_read, 3u);
+	ASSERT_EQUAL(cat.predicate_calls, 3u);
+	// The only "groomed" document is banned: an ACTUAL query does not even read its posting.
+	const TermExplanation groomed = find_term(dense, "groomed"s);
+	ASSERT_EQUAL(groomed.posting_count, 1u);
+	ASSERT_EQUAL(groomed.postings_read, 0u);
+	ASSERT_EQUAL(groomed.predicate_calls, 0u);
+	const TermExplanation white = find_term(dense, "white"s);
+	ASSERT(white.role == TermRole::MINUS);
+	ASSERT_EQUAL(white.excluded_documents, 1u);
+	vector<string> stages;
+	for (const StageExplanation& stage : dense.stages) {
+		stages.push_back(stage.name);
+	}
+	ASSERT((stages == vector<string>{"parse"s, "expand"s, "score"s, "minus words"s, "select top"s}));
+	ASSERT_EQUAL(dense.stages[2].document_count, 3u);
+	ASSERT_EQUAL(dense.stages[3].document_count, 2u);
+
+	const QueryExplanation conjunctive = server.ExplainTopDocuments("+cat cat* -fluffy"s);
+	ASSERT_EQUAL(conjunctive.path, "conjunctive"s);
+	ASSERT_EQUAL(conjunctive.documents.size(), 2u);
+	ASSERT(find_term(conjunctive, "catfish"s).role == TermRole::PREFIX_EXPANSION);
+	ASSERT_EQUAL(find_term(conjunctive, "fluffy"s).excluded_documents, 1u);
+
+	server.BuildImpactOrder(1);
+	const QueryExplanation impact = server.ExplainTopDocuments("dog"s, DocumentStatus::ACTUAL);
+	ASSERT_EQUAL(impact.path, "impact"s);
+	ASSERT_EQUAL(impact.documents.size(), 1u);
+	ASSERT_EQUAL(find_term(impact, "dog"s).postings_read, 1u);
+	ASSERT_EQUAL(find_term(impact, "dog"s).predicate_rejections, 0u);
+	// Minus words get their own rows on the impact path too.
+	const QueryExplanation impact_minus = server.ExplainTopDocuments("dog -whit*"s, DocumentStatus::ACTUAL);
+	ASSERT_EQUAL(impact_minus.path, "impact"s);
+	ASSERT(impact_minus.documents.empty());
+	ASSERT_EQUAL(find_term(impact_minus, "dog"s).excluded_documents, 0u);
+	const TermExplanation impact_white = find_term(impact_minus, "white"s);
+	ASSERT(impact_white.role == TermRole::MINUS);
+	ASSERT_EQUAL(impact_white.postings_read, 1u);
+	ASSERT_EQUAL(impact_white.excluded_documents, 1u);
+	ASSERT_EQUAL(impact_minus.stages[1].name, "expand"s);
+	ostringstream out;
+	out << impact;
+	ASSERT(out.str().find("path: impact"s) != string::npos);
+}
+
+void TestStatusPartitions() {
+	using namespace std;
+	const vector<string> fillers = {"dog"s, "city"s, "village"s, "bird"s, "fish"s};
+	const auto status_of = [](int id, int round) {
+		return static_cast<DocumentStatus>((id + round) % 7 % DOCUMENT_STATUS_COUNT);
+	};
+	// Same documents, statuses of round: built from scratch, or built with round 0 and moved by SetDocumentStatus.
+	const auto make_server = [&fillers, &status_of](int round) {
+		auto server = make_unique<SearchServer>("and"s);
+		server->EnablePositionalIndex();
+		for (int id = 0; id < 400; ++id) {
+			string text = "cat"s;
+			for (int i = 0; i < id % 6; ++i) {
+				text += " "s + fillers[(id + i) % fillers.size()];
+			}
+			server->AddDocument(id, text, status_of(id, round), {id % 11});
+		}
+		return server;
+	};
+	const auto compare = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+		ASSERT_EQUAL(lhs.size(), rhs.size());
+		for (size_t i = 0; i < lhs.size(); ++i) {
+			ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+			ASSERT_EQUAL(lhs[i].relevance, rhs[i].relevance);
+		}
+	};
+	const vector<string> queries = {"cat"s, "dog bird"s, "cat -dog"s, "+dog +bird"s, "+cat fish -vil*"s, "ci* bird"s, "\"dog city\""s, "cat dog NEAR/1 city"s};
+
+	auto moved = make_server(0);
+	moved->BuildImpactOrder(10);
+	// Documents leave postings behind, come back to them and leave again before settling on round 1.
+	for (const int round : {1, 2, 3, 0, 1}) {
+		for (int id = 0; id < 400; ++id) {
+			moved->SetDocumentStatus(id, status_of(id, round));
+		}
+	}
+	const auto rebuilt = make_server(1);
+	for (const auto* server : {moved.get(), rebuilt.get()}) {
+		for (const string& query : queries) {
+			for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status) {
+				const auto expected = server->FindTopDocuments(query, [status](int document_id, DocumentStatus document_status, int rating) {
+					return document_status == static_cast<DocumentStatus>(status);
+				});
+				compare(server->FindTopDocuments(query, static_cast<DocumentStatus>(status)), expected);
+				compare(server->FindTopDocuments(execution::par, query, static_cast<DocumentStatus>(status)), expected);
+				compare(rebuilt->FindTopDocuments(query, static_cast<DocumentStatus>(status)), expected);
+			}
+			compare(server->FindTopDocuments(query, [](int document_id, DocumentStatus status, int rating) { return document_id % 3 != 0; }),
+					rebuilt->FindTopDocuments(query, [](int document_id, DocumentStatus status, int rating) { return document_id % 3 != 0; }));
+		}
+	}
+	ASSERT(get<DocumentStatus>(moved->MatchDocument("cat"s, 5)) == status_of(5, 1));
+	ASSERT_EQUAL(moved->GetTermMemory("cat"s).document_count, 400u);
+
+	// Moved postings keep the impact-ordered copies current, and a status query reads only its own partition.
+	const QueryExplanation impact = moved->ExplainTopDocuments("cat"s, DocumentStatus::BANNED);
+	ASSERT_EQUAL(impact.path, "impact"s);
+	compare(impact.documents, rebuilt->FindTopDocuments("cat"s, DocumentStatus::BANNED));
+	ASSERT_EQUAL(impact.terms.front().predicate_rejections, 0u);
+	const QueryExplanation dense = rebuilt->ExplainTopDocuments("cat bird"s, DocumentStatus::REMOVED);
+	ASSERT(dense.terms.front().postings_read < dense.terms.front().posting_count);
+	ASSERT_EQUAL(dense.terms.front().predicate_rejections, 0u);
+
+	moved->ReorderDocuments();
+	for (const string& query : queries) {
+		compare(moved->FindTopDocuments(query, [](int document_id, DocumentStatus status, int rating) { return true; }),
+				rebuilt->FindTopDocuments(query, [](int document_id, DocumentStatus status, int rating) { return true; }));
+		compare(moved->FindTopDocuments(query, DocumentStatus::IRRELEVANT), rebuilt->FindTopDocuments(query, DocumentStatus::IRRELEVANT));
+	}
+	const auto moved_batch = moved->FindTopDocumentsBatch(queries, DocumentStatus::BANNED);
+	const auto rebuilt_batch = rebuilt->FindTopDocumentsBatch(queries, DocumentStatus::BANNED);
+	for (size_t i = 0; i < queries.size(); ++i) {
+		compare(moved_batch[i], rebuilt_batch[i]);
+	}
+
+	moved->SetDocumentStatus(7, DocumentStatus::REMOVED);
+	moved->SetDocumentStatus(7, DocumentStatus::REMOVED);
+	moved->RemoveDocument(7);
+	ASSERT(moved->FindTopDocuments("cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id == 7; }).empty());
+	try {
+		moved->SetDocumentStatus(7, DocumentStatus::ACTUAL);
+		ASSERT_HINT(false, "Unknown ids must throw"s);
+	} catch (const out_of_range&) {
+	}
+}
+
 void TestRemoveDuplicates() {
 	using namespace std;
 	cout << endl;
@@ -328,6 +1451,26 @@ void TestSearchServer() {
 	TestStatus();
 	TestRelevantCalculated();
 	TestMatchDocument();
+	TestPaginateSearch();
+	TestMemoryResource();
+	TestPhraseAndProximity();
+	TestPrefixQuery();
+	TestConjunctiveQuery();
+	TestLoadCorpus();
+	TestQueryBudget();
+	TestDenseScoring();
+	TestRemovedPostings();
+	TestReorderDocuments();
+	TestBatchQueries();
+	TestImpactOrder();
+	TestDuplicateDetection();
+	TestLatencyHistogram();
+	TestFuzzyMatching();
+	TestConcurrentIngest();
+	TestHashedLookups();
+	TestMemoryIntrospection();
+	TestExplainMode();
+	TestStatusPartitions();
 	std::cout << "Done." << std::endl;
 	TestExecutionPolicy();
 	TestRemoveDuplicates();
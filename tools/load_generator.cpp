@@ -0,0 +1,353 @@
+// Load generator for SearchServer: loads a corpus, then replays a query log or generated queries from
+// several client threads and reports throughput and latency percentiles.
+//
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -Isrc tools/load_generator.cpp $(ls src/*.cpp | grep -v main.cpp) -o load_generator -ltbb -lpthread
+//
+// Closed loop: every thread sends its next request as soon as the previous one returns. Its response
+// times are corrected for coordinated omission only against an --expected-interval-us given by the
+// caller: an interval taken from the run itself would hide the very stalls the correction is for.
+// Open loop: requests are due at a fixed total rate whatever the server does; response time is measured
+// from the moment a request was due, so queueing behind slow requests is not omitted.
+
+#include "corpus_loader.h"
+#include "latency_histogram.h"
+#include "process_queries.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+enum class Api {
+	FIND,
+	PROCESS,
+	MATCH,
+};
+
+struct Options {
+	string corpus_path;
+	string stop_words;
+	string query_log_path;
+	size_t generated_query_count = 10000;
+	int plus_word_count = 2;
+	int minus_word_count = 0;
+	int stop_word_count = 0;
+	Api api = Api::FIND;
+	size_t batch_size = 100;
+	bool is_open_loop = false;
+	double rate = 1000.0;
+	size_t thread_count = 1;
+	double duration_seconds = 10.0;
+	size_t request_count = 0;
+	// Closed loop only; without it response times are not corrected.
+	optional<double> expected_interval_us;
+	unsigned seed = 1;
+};
+
+void PrintUsage() {
+	cerr << "Usage: load_generator --corpus PATH [options]\n"s
+			"  --stop-words \"a b c\"       stop words of the server, also used by generated queries\n"s
+			"  --queries PATH             replay a query log, one query per line\n"s
+			"  --generate N               otherwise generate N queries from corpus words (10000)\n"s
+			"  --plus K --minus K --stop K  words of each kind per generated query (2, 0, 0)\n"s
+			"  --api find|process|match   FindTopDocuments, ProcessQueries batches or MatchDocument (find)\n"s
+			"  --batch N                  queries per ProcessQueries request (100)\n"s
+			"  --mode closed|open         closed or fixed-rate open loop (closed)\n"s
+			"  --rate QPS                 total request rate of the open loop (1000)\n"s
+			"  --threads N                client threads (1)\n"s
+			"  --duration SECONDS         run time (10)\n"s
+			"  --requests N               stop after N requests instead\n"s
+			"  --expected-interval-us US  closed-loop interval for the omission correction (none: no correction)\n"s
+			"  --seed N                   random seed of generated queries (1)\n"s;
+}
+
+Options ParseOptions(int argc, char* argv[]) {
+	Options options;
+	for (int i = 1; i < argc; i += 2) {
+		const string name = argv[i];
+		if (i + 1 >= argc) {
+			throw invalid_argument("Missing value of "s + name);
+		}
+		const string value = argv[i + 1];
+		if (name == "--corpus"s) {
+			options.corpus_path = value;
+		} else if (name == "--stop-words"s) {
+			options.stop_words = value;
+		} else if (name == "--queries"s) {
+			options.query_log_path = value;
+		} else if (name == "--generate"s) {
+			options.generated_query_count = stoul(value);
+		} else if (name == "--plus"s) {
+			options.plus_word_count = stoi(value);
+		} else if (name == "--minus"s) {
+			options.minus_word_count = stoi(value);
+		} else if (name == "--stop"s) {
+			options.stop_word_count = stoi(value);
+		} else if (name == "--api"s) {
+			if (value == "find"s) {
+				options.api = Api::FIND;
+			} else if (value == "process"s) {
+				options.api = Api::PROCESS;
+			} else if (value == "match"s) {
+				options.api = Api::MATCH;
+			} else {
+				throw invalid_argument("Unknown api "s + value);
+			}
+		} else if (name == "--batch"s) {
+			options.batch_size = max<size_t>(1, stoul(value));
+		} else if (name == "--mode"s) {
+			if (value != "closed"s && value != "open"s) {
+				throw invalid_argument("Unknown mode "s + value);
+			}
+			options.is_open_loop = value == "open"s;
+		} else if (name == "--rate"s) {
+			options.rate = stod(value);
+		} else if (name == "--threads"s) {
+			options.thread_count = max<size_t>(1, stoul(value));
+		} else if (name == "--duration"s) {
+			options.duration_seconds = stod(value);
+		} else if (name == "--requests"s) {
+			options.request_count = stoul(value);
+		} else if (name == "--expected-interval-us"s) {
+			options.expected_interval_us = stod(value);
+		} else if (name == "--seed"s) {
+			options.seed = static_cast<unsigned>(stoul(value));
+		} else {
+			throw invalid_argument("Unknown option "s + name);
+		}
+	}
+	if (options.corpus_path.empty()) {
+		throw invalid_argument("--corpus is required"s);
+	}
+	if (options.is_open_loop && options.rate <= 0.0) {
+		throw invalid_argument("--rate must be positive"s);
+	}
+	if (options.expected_interval_us && *options.expected_interval_us <= 0.0) {
+		throw invalid_argument("--expected-interval-us must be positive"s);
+	}
+	return options;
+}
+
+vector<string> LoadQueryLog(const string& path) {
+	ifstream input(path);
+	if (!input) {
+		throw runtime_error("Cannot open "s + path);
+	}
+	vector<string> queries;
+	for (string line; getline(input, line);) {
+		if (!line.empty()) {
+			queries.push_back(move(line));
+		}
+	}
+	return queries;
+}
+
+// Plus words are drawn from the words of sampled documents, so frequent words come up as often as in the corpus.
+vector<string> GenerateQueries(const SearchServer& search_server, const Options& options) {
+	vector<string> words;
+	const size_t stride = max<size_t>(1, search_server.GetDocumentCount() / 10000);
+	size_t index = 0;
+	for (const int document_id : search_server) {
+		if (index++ % stride == 0) {
+			for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)) {
+				words.emplace_back(word);
+			}
+		}
+	}
+	const vector<string_view> stop_words = SplitIntoWords(options.stop_words);
+	if (words.empty() || (options.stop_word_count > 0 && stop_words.empty())) {
+		throw invalid_argument("Not enough words to generate queries"s);
+	}
+	mt19937 generator(options.seed);
+	uniform_int_distribution<size_t> word_distribution(0, words.size() - 1);
+	uniform_int_distribution<size_t> stop_word_distribution(0, stop_words.empty() ? 0 : stop_words.size() - 1);
+	vector<string> queries;
+	queries.reserve(options.generated_query_count);
+	for (size_t i = 0; i < options.generated_query_count; ++i) {
+		vector<string> query_words;
+		for (int j = 0; j < options.plus_word_count; ++j) {
+			query_words.push_back(words[word_distribution(generator)]);
+		}
+		for (int j = 0; j < options.minus_word_count; ++j) {
+			query_words.push_back("-"s + words[word_distribution(generator)]);
+		}
+		for (int j = 0; j < options.stop_word_count; ++j) {
+			query_words.emplace_back(stop_words[stop_word_distribution(generator)]);
+		}
+		shuffle(query_words.begin(), query_words.end(), generator);
+		string query;
+		for (const string& word : query_words) {
+			query += (query.empty() ? ""s : " "s) + word;
+		}
+		queries.push_back(move(query));
+	}
+	return queries;
+}
+
+struct ClientResult {
+	LatencyHistogram service_times;
+	// Open loop only: measured from the moment the request was due.
+	LatencyHistogram response_times;
+	uint64_t error_count = 0;
+};
+
+class LoadRunner {
+public:
+	using Clock = chrono::steady_clock;
+
+	LoadRunner(const SearchServer& search_server, const Options& options, const vector<string>& queries)
+		: search_server_(search_server)
+		, options_(options)
+		, queries_(queries)
+		, document_ids_(search_server.begin(), search_server.end()) {
+		for (size_t first = 0; first < queries_.size(); first += options_.batch_size) {
+			batches_.emplace_back(queries_.begin() + first, queries_.begin() + min(queries_.size(), first + options_.batch_size));
+		}
+	}
+
+	vector<ClientResult> Run() {
+		vector<ClientResult> results(options_.thread_count);
+		start_ = Clock::now();
+		deadline_ = start_ + chrono::duration_cast<Clock::duration>(chrono::duration<double>(options_.duration_seconds));
+		vector<thread> clients;
+		for (size_t i = 0; i < options_.thread_count; ++i) {
+			clients.emplace_back([this, &result = results[i]]() {
+				RunClient(result);
+			});
+		}
+		for (thread& client : clients) {
+			client.join();
+		}
+		finish_ = Clock::now();
+		return results;
+	}
+
+	double GetElapsedSeconds() const {
+		return chrono::duration<double>(finish_ - start_).count();
+	}
+
+private:
+	void RunClient(ClientResult& result) {
+		const auto interval = chrono::duration<double, nano>(1e9 / options_.rate);
+		while (true) {
+			const size_t index = next_request_.fetch_add(1);
+			if (options_.request_count > 0 ? index >= options_.request_count : Clock::now() >= deadline_) {
+				return;
+			}
+			Clock::time_point due = Clock::now();
+			if (options_.is_open_loop) {
+				due = start_ + chrono::duration_cast<Clock::duration>(interval * static_cast<double>(index));
+				if (options_.request_count == 0 && due >= deadline_) {
+					return;
+				}
+				this_thread::sleep_until(due);
+			}
+			const auto sent = Clock::now();
+			try {
+				SendRequest(index);
+			} catch (const exception&) {
+				++result.error_count;
+			}
+			const auto received = Clock::now();
+			result.service_times.Record(chrono::duration_cast<chrono::nanoseconds>(received - sent).count());
+			if (options_.is_open_loop) {
+				result.response_times.Record(chrono::duration_cast<chrono::nanoseconds>(received - due).count());
+			}
+		}
+	}
+
+	void SendRequest(size_t index) const {
+		switch (options_.api) {
+		case Api::FIND:
+			search_server_.FindTopDocuments(queries_[index % queries_.size()]);
+			break;
+		case Api::PROCESS:
+			ProcessQueries(search_server_, batches_[index % batches_.size()]);
+			break;
+		case Api::MATCH:
+			search_server_.MatchDocument(queries_[index % queries_.size()], document_ids_[(index * 7919) % document_ids_.size()]);
+			break;
+		}
+	}
+
+	const SearchServer& search_server_;
+	const Options& options_;
+	const vector<string>& queries_;
+	const vector<int> document_ids_;
+	vector<vector<string>> batches_;
+	atomic<size_t> next_request_{0};
+	Clock::time_point start_;
+	Clock::time_point deadline_;
+	Clock::time_point finish_;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	Options options;
+	try {
+		options = ParseOptions(argc, argv);
+	} catch (const exception& e) {
+		cerr << e.what() << endl;
+		PrintUsage();
+		return 1;
+	}
+	try {
+		SearchServer search_server(options.stop_words);
+		const size_t document_count = LoadCorpus(search_server, options.corpus_path);
+		if (document_count == 0) {
+			throw runtime_error("Empty corpus"s);
+		}
+		const vector<string> queries = options.query_log_path.empty() ? GenerateQueries(search_server, options) : LoadQueryLog(options.query_log_path);
+		if (queries.empty()) {
+			throw runtime_error("No queries"s);
+		}
+		cout << "Documents: "s << document_count << ", queries: "s << queries.size() << endl;
+
+		LoadRunner runner(search_server, options, queries);
+		ClientResult total;
+		for (const ClientResult& result : runner.Run()) {
+			total.service_times.Merge(result.service_times);
+			total.response_times.Merge(result.response_times);
+			total.error_count += result.error_count;
+		}
+		const bool is_corrected = options.is_open_loop || options.expected_interval_us.has_value();
+		if (!options.is_open_loop && is_corrected) {
+			total.response_times = total.service_times.GetCorrectedCopy(static_cast<uint64_t>(*options.expected_interval_us * 1000.0));
+		}
+
+		const uint64_t request_count = total.service_times.GetTotalCount();
+		if (options.is_open_loop) {
+			cout << "Open loop at "s << options.rate << " QPS"s;
+		} else {
+			cout << "Closed loop"s;
+		}
+		cout << ", threads: "s << options.thread_count << endl;
+		cout << "Requests: "s << request_count << ", errors: "s << total.error_count
+				<< ", elapsed: "s << runner.GetElapsedSeconds() << " s, throughput: "s << request_count / runner.GetElapsedSeconds() << " QPS"s << endl;
+		cout << "\nService time:\n"s;
+		total.service_times.Print(cout);
+		if (is_corrected) {
+			cout << "\nResponse time, corrected for coordinated omission:\n"s;
+			total.response_times.Print(cout);
+		} else {
+			cout << "\nResponse time not corrected for coordinated omission: pass --expected-interval-us.\n"s;
+		}
+	} catch (const exception& e) {
+		cerr << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}